@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Streaming polyphase resampler between two fixed sample rates.
+ *
+ * The rate ratio is reduced to L/M by their gcd, and a Kaiser windowed-sinc low-pass at L times the input rate
+ * is split into L phases of equal length. Every output sample is then a single dot product of one phase with the
+ * latest input samples.
+ */
+class Resampler {
+public:
+    enum class Quality {
+        /** 64 taps per phase (times the decimation factor when downsampling), 90 dB stop band */
+        standard,
+        /** 16 taps per phase, 60 dB stop band and a wider transition, for a quarter of the delay */
+        lowLatency
+    };
+
+    Resampler(uint32_t inputRate, uint32_t outputRate, Quality quality = Quality::standard);
+
+    /**
+     * Resamples inputFrames samples into out and returns the number of samples written,
+     * which is at most getMaxOutput(inputFrames).
+     */
+    size_t process(const float *in, size_t inputFrames, float *out);
+
+    size_t getMaxOutput(size_t inputFrames) const;
+
+    /**
+     * Group delay of the filter, in output samples.
+     */
+    double getLatency() const;
+
+    void reset();
+
+private:
+    uint32_t m_upFactor;
+    uint32_t m_downFactor;
+    uint32_t m_taps;
+
+    /**
+     * m_upFactor phases of m_taps coefficients each, stored oldest sample first.
+     */
+    std::vector<float> m_coefs;
+
+    /**
+     * The last m_taps input samples, written twice so that they can always be read as one contiguous block.
+     */
+    std::vector<float> m_history;
+    uint32_t m_historyPos{0};
+    uint32_t m_phase{0};
+};
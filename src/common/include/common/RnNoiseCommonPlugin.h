@@ -6,46 +6,238 @@
 #include <vector>
 #include <unordered_map>
 
+#include "common/Resampler.h"
+#include "common/WorkerPool.h"
+
 struct DenoiseState;
 
 class RnNoiseCommonPlugin {
 public:
 
-    void init();
+    /**
+     * All the channels go through process() together, with the same block sizes.
+     *
+     * With 4 or more channels, unlinked channels are denoised in parallel, on up to one thread per channel, when a
+     * block holds at least a whole rnnoise frame.
+     */
+    explicit RnNoiseCommonPlugin(uint32_t channels = 1);
+
+    ~RnNoiseCommonPlugin();
+
+    /**
+     * rnnoise runs natively at 48 and 16 kHz, audio at any other sampleRate is resampled to and from 48 kHz around it.
+     *
+     * blockSize is the number of samples the host passes to process() every time, or 0 if it is not known yet, the
+     * first block then stands in for it. Without resampling it decides how far behind the output has to start so
+     * that it never runs dry, see getLatency(). The resampled path always allows for any block size.
+     *
+     * lowLatency runs rnnoise on 5 ms frames and picks the shorter resampling filters, for about half the delay.
+     */
+    void init(uint32_t sampleRate = k_denoiseSampleRate, uint32_t blockSize = 0, bool lowLatency = false);
 
     void deinit();
 
+    /**
+     * in and out hold one buffer per channel.
+     *
+     * A new vadThreshold is ramped to over a few frames, so that it can come straight from a control without
+     * the gate chattering while it moves. vadRelease is in 10 ms steps.
+     */
+    void process(const float *const *in, float *const *out, int32_t sampleFrames, float vadThreshold,
+                 short vadRelease = k_vadGracePeriodSamples);
+
+    /**
+     * Single channel shorthand.
+     */
     void process(const float *in, float *out, int32_t sampleFrames, float vadThreshold, short vadRelease = k_vadGracePeriodSamples);
 
+    /**
+     * Linked channels share one rnnoise inference, on their mean, and get the same gains and the same VAD gate.
+     * This costs one network and pitch search for all of them and keeps the stereo image steady. Changing it
+     * restarts the denoisers, like setModel().
+     */
+    void setLinked(bool linked);
+
+    bool isLinked() const { return m_linked; }
+
+    /**
+     * Keeps the VAD running without gating, for getVadProbability().
+     */
+    void setVadMetering(bool enabled) { m_vadMetering = enabled; }
+
+    /**
+     * Voice probability of the last denoised frame, the highest of all channels. Without gating the VAD does not
+     * run and this is 1, unless setVadMetering() is on.
+     */
+    float getVadProbability() const { return m_vadProbability; }
+
     void setModel(const std::string name);
 
     const std::string& getCurrentModel() { return m_model; }
 
+    /**
+     * The rnnoise states of all the channels for one model.
+     */
+    struct Denoisers {
+        std::string model;
+        bool linked = false;
+        uint32_t denoiseRate = k_denoiseSampleRate;
+        short framesPer10ms = 1;
+        int frameSize = k_denoiseFrameSize;
+
+        /**
+         * One per channel and, when linked, the state of the mix last.
+         */
+        std::vector<std::shared_ptr<DenoiseState>> states;
+        std::vector<DenoiseState *> channelStates;
+    };
+
+    /**
+     * Allocates the rnnoise states for a model and linking, for the current channels, rate and frame mode.
+     * Unlike setModel() and setLinked() it leaves the running denoisers alone, so it can run on another thread
+     * than process(), and the result is put in place with swapDenoisers().
+     */
+    std::unique_ptr<Denoisers> createDenoisers(const std::string &model, bool linked) const;
+
+    /**
+     * Puts denoisers from createDenoisers() in place, with their model and linking, without allocating or freeing
+     * anything, and hands back the previous ones so that they can be freed away from the audio thread. The
+     * buffered audio carries on.
+     *
+     * Returns false and leaves denoisers as they are if init() has changed what they were made for.
+     */
+    bool swapDenoisers(std::unique_ptr<Denoisers> &denoisers);
+
+    /**
+     * Delay from input to output, in samples at the host rate: one rnnoise frame of overlap-add, the input that
+     * waits for a whole frame and, at other rates than 48 and 16 kHz, the resampling filters.
+     *
+     * Without a block size from init() it is only settled by the first process(). After that it only changes if
+     * the host passes another block size and the output runs dry, the delay then grows by the missing samples.
+     */
+    uint32_t getLatency() const { return m_latency; }
+
     static const std::vector<std::string>& getAvailableModels();
 
 private:
 
+    /**
+     * Called with m_stateLock held.
+     */
     void createDenoiseState();
 
+    /**
+     * Delays the output of the unresampled path for blocks of blockSize, see init().
+     */
+    void primeOutput(uint32_t blockSize);
+
+    struct Channel;
+
+    /**
+     * Appends the block to the channel's input buffer, resampled to the rnnoise rate if needed.
+     */
+    void bufferInput(Channel &channel, const float *in, int32_t sampleFrames);
+
+    /**
+     * Moves the first framesToProcess frames of the input buffer, denoised in place, to the output buffer and
+     * fills out from there. Returns the number of samples that were available, the rest of out is silence.
+     */
+    size_t drainOutput(Channel &channel, size_t framesToProcess, float *out, int32_t sampleFrames);
+
+    /**
+     * Denoises one frame of every linked channel, the buffers are set in m_frameIn and m_frameOut.
+     */
+    void denoiseLinkedFrame(float vadThreshold, short vadRelease, bool gateEnabled);
+
+    /**
+     * Silences a denoised frame while the VAD gate is closed, and moves the channel's threshold a step towards
+     * vadThreshold. Without gating the VAD result is only kept for getVadProbability(), and is 1 unless metered.
+     */
+    void gateFrame(float *frame, Channel &channel, float vadProbability, float vadThreshold, short vadRelease,
+                   bool gateEnabled);
+
 private:
     static const int k_denoiseFrameSize = 480;
     static const int k_denoiseSampleRate = 48000;
+    static const int k_widebandSampleRate = 16000;
+
+    /**
+     * Fewer channels, stereo in particular, stay on the audio thread rather than wait for the workers.
+     */
+    static const uint32_t k_minParallelChannels = 4;
 
     /**
      * The amount of samples that aren't silenced, regardless of rnnoise's VAD result, after one was detected.
      * This fixes cut outs in the middle of words.
-     * Each sample is 10ms.
+     * Each sample is 10ms, whatever the rnnoise frame size.
      */
     static const short k_vadGracePeriodSamples = 20;
 
+    /**
+     * How far the gate threshold moves in 10 ms, a jump across the whole range takes 100 ms.
+     */
+    static constexpr float k_vadThresholdRampPer10ms = 0.1f;
+
+    struct Channel {
+        std::vector<float> inputBuffer;
+        std::vector<float> outputBuffer;
+
+        std::unique_ptr<Resampler> inputResampler;
+        std::unique_ptr<Resampler> outputResampler;
+
+        short remainingGracePeriod = 0;
+
+        /**
+         * The gate threshold on its way to the one passed to process(), below 0 until the first frame after
+         * init(), which starts right at it. Every channel takes the same steps.
+         */
+        float vadThreshold = -1.f;
+
+        /**
+         * Of the last frame that was denoised.
+         */
+        float vadProbability = 0.f;
+    };
+
     std::mutex m_stateLock;
-    std::shared_ptr<DenoiseState> m_denoiseState;
+
+    std::unique_ptr<Denoisers> m_denoisers;
     std::string m_model{ "default" };
+    bool m_linked = false;
+    bool m_vadMetering = false;
+
+    /**
+     * The rate rnnoise runs at and its frame size there, 10 ms of audio.
+     */
+    uint32_t m_denoiseRate = k_denoiseSampleRate;
+    int m_frameSize = k_denoiseFrameSize;
+
+    /**
+     * rnnoise frames per 10 ms, 2 in the low-latency mode.
+     */
+    short m_framesPer10ms = 1;
 
-    short m_remainingGracePeriod = 0;
+    std::vector<Channel> m_channels;
 
-    std::vector<float> m_inputBuffer;
-    std::vector<float> m_outputBuffer;
+    /**
+     * The frame of each channel that denoiseLinkedFrame() works on.
+     */
+    std::vector<const float *> m_frameIn;
+    std::vector<float *> m_frameOut;
+
+    /**
+     * Spare threads for unlinked channels, and the host block size from which they are used.
+     */
+    std::unique_ptr<WorkerPool> m_workers;
+    int32_t m_parallelBlockSize = k_denoiseFrameSize;
+
+    uint32_t m_latency = 0;
+
+    /**
+     * init() was not given a block size, the next process() primes the output.
+     */
+    bool m_primingPending = false;
+    float m_vadProbability = 0.f;
 };
 
 
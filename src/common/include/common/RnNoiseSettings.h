@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * The plugin settings that the wrappers save with the host's session, in one binary format for all of them.
+ *
+ * The blob is little-endian, k_size bytes in this version:
+ *   0  magic "RNNS"
+ *   4  uint16 version, k_version
+ *   6  uint16 size of the whole blob
+ *   8  float  VAD threshold, 0 to 1
+ *   12 uint16 VAD release, in 10 ms steps, up to 1 s
+ *   14 uint16 reserved, 0
+ *   16 uint32 FNV-1a hash of the model name
+ *   20 uint32 flags, see Flags
+ *
+ * Later versions may only append fields and grow the size, so that older plugins can still read what they know.
+ */
+struct RnNoiseSettings {
+    static const uint16_t k_version = 1;
+    static const size_t k_size = 24;
+
+    enum Flags : uint32_t {
+        linked = 1u << 0,
+    };
+
+    float vadThreshold = 0.f;
+    short vadRelease = 20;
+
+    /**
+     * Into RnNoiseCommonPlugin::getAvailableModels(). A model that this build does not know reads as the default.
+     */
+    size_t modelIndex = 0;
+
+    uint32_t flags = 0;
+
+    using Blob = std::array<uint8_t, k_size>;
+
+    Blob serialize() const;
+
+    /**
+     * Reads a blob of at least the version 1 size. Nothing is allocated and nothing throws, if the data is not
+     * valid this returns false and leaves the settings as they are.
+     */
+    bool parse(const void *data, size_t size);
+
+    static uint32_t hashModelName(const std::string &name);
+
+    /**
+     * Index of a model name, or of the default model if there is no such model.
+     */
+    static size_t findModel(const std::string &name);
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A few threads that share the work of a loop with the thread that runs it.
+ *
+ * The threads are started once and sleep between the loops, so that a loop only costs a wake-up.
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * Calls task(index) for every index below count, on the workers and on the calling thread,
+     * and returns once all the calls are done. The task is not copied, so nothing is allocated.
+     */
+    template<class Task>
+    void run(size_t count, Task &task) {
+        run(count, [](void *context, size_t index) { (*static_cast<Task *>(context))(index); }, &task);
+    }
+
+    size_t size() const { return m_threads.size(); }
+
+private:
+    using TaskFunction = void (*)(void *context, size_t index);
+
+    void run(size_t count, TaskFunction function, void *context);
+
+    void work();
+
+    /**
+     * Calls the task for the indices that nobody has taken yet.
+     */
+    void takeTasks(TaskFunction function, void *context, size_t count);
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    /**
+     * The loop being run, or null once run() has returned. Guarded by m_mutex.
+     */
+    TaskFunction m_task = nullptr;
+    void *m_context = nullptr;
+    size_t m_count = 0;
+    uint64_t m_generation = 0;
+    size_t m_activeWorkers = 0;
+    bool m_stop = false;
+
+    std::atomic<size_t> m_next{0};
+    std::atomic<size_t> m_finished{0};
+};
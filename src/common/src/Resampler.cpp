@@ -0,0 +1,156 @@
+#include "common/Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+static const double k_pi = 3.14159265358979323846;
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind, order 0
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// n must be a multiple of 8
+static float dotProduct(const float *a, const float *b, uint32_t n) {
+#if defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    uint32_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8]), acc1);
+#else
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8])));
+#endif
+    }
+    if (i < n) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])));
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+#elif defined(__SSE__) || defined(_M_X64)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (uint32_t i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&a[i + 4]), _mm_loadu_ps(&b[i + 4])));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+#else
+    float sum = 0.f;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+#endif
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64)
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+#endif
+}
+
+Resampler::Resampler(uint32_t inputRate, uint32_t outputRate, Quality quality) {
+    const uint32_t divisor = greatestCommonDivisor(inputRate, outputRate);
+    m_upFactor = outputRate / divisor;
+    m_downFactor = inputRate / divisor;
+    // The filter spans the same time at the lower of the two rates, so a downsampler gets proportionally more taps
+    const uint32_t decimation = (inputRate + outputRate - 1) / outputRate;
+    m_taps = (quality == Quality::lowLatency ? 16 : 64) * decimation;
+    const double attenuation = quality == Quality::lowLatency ? 60.0 : 90.0;
+
+    // Kaiser's estimates: the transition width that the window length allows for this attenuation, placed so that
+    // the stop band starts at the lower Nyquist frequency.
+    const double beta = 0.1102 * (attenuation - 8.7);
+    const double transition = (attenuation - 8.0) / (2.285 * 2 * k_pi) * inputRate / m_taps;
+    const double nyquist = 0.5 * std::min(inputRate, outputRate);
+    const double cutoff = std::max(nyquist - 0.5 * transition, 0.5 * nyquist);
+
+    const uint32_t length = m_taps * m_upFactor;
+    const double center = 0.5 * (length - 1);
+    const double normalizedCutoff = cutoff / (static_cast<double>(inputRate) * m_upFactor);
+    std::vector<double> prototype(length);
+    for (uint32_t j = 0; j < length; j++) {
+        const double t = j - center;
+        const double x = 2 * k_pi * normalizedCutoff * t;
+        const double sinc = t == 0 ? 1.0 : std::sin(x) / x;
+        const double ratio = t / (center + 0.5);
+        const double window = besselI0(beta * std::sqrt(std::max(0.0, 1 - ratio * ratio))) / besselI0(beta);
+        prototype[j] = sinc * window;
+    }
+
+    // Phase p reads prototype[p + k*L] against input sample i-k. Each phase is normalized to unity DC gain,
+    // which also removes the ripple between phases.
+    m_coefs.resize(static_cast<size_t>(m_upFactor) * m_taps);
+    for (uint32_t p = 0; p < m_upFactor; p++) {
+        double sum = 0;
+        for (uint32_t k = 0; k < m_taps; k++) {
+            sum += prototype[p + k * m_upFactor];
+        }
+        for (uint32_t k = 0; k < m_taps; k++) {
+            m_coefs[p * m_taps + (m_taps - 1 - k)] = static_cast<float>(prototype[p + k * m_upFactor] / sum);
+        }
+    }
+
+    reset();
+}
+
+size_t Resampler::process(const float *in, size_t inputFrames, float *out) {
+    size_t produced = 0;
+
+    for (size_t i = 0; i < inputFrames; i++) {
+        m_history[m_historyPos] = in[i];
+        m_history[m_historyPos + m_taps] = in[i];
+        if (++m_historyPos == m_taps) {
+            m_historyPos = 0;
+        }
+
+        // Oldest to newest sample
+        const float *window = &m_history[m_historyPos];
+        while (m_phase < m_upFactor) {
+            out[produced++] = dotProduct(&m_coefs[m_phase * m_taps], window, m_taps);
+            m_phase += m_downFactor;
+        }
+        m_phase -= m_upFactor;
+    }
+
+    return produced;
+}
+
+size_t Resampler::getMaxOutput(size_t inputFrames) const {
+    return (inputFrames * m_upFactor + m_downFactor - 1) / m_downFactor + 1;
+}
+
+double Resampler::getLatency() const {
+    return (static_cast<double>(m_taps) * m_upFactor - 1) / (2.0 * m_downFactor);
+}
+
+void Resampler::reset() {
+    m_history.assign(2 * m_taps, 0.f);
+    m_historyPos = 0;
+    m_phase = 0;
+}
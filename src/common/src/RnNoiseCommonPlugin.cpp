@@ -2,155 +2,360 @@
 
 #include <cstring>
 #include <ios>
-#include <limits>
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <thread>
 
 
 #include <rnnoise.h>
 #include <rnnoise-nu.h>
 
+#include "RnNoiseModels.h"
+
 static const std::unordered_map<std::string, std::string> g_modelsMap = {
-    {"default", "orig"},
-    {"beguiling-drafter-2018-08-30", "bd"},
-    {"conjoined-burgers-2018-08-28", "cb"},
-    {"leavened-quisling-2018-08-31", "lq"},
-    {"marathon-prescription-2018-08-29", "mp"},
-    {"somnolent-hogwash-2018-09-01", "sh"}
+    RNNOISE_PLUGIN_MODEL_IDS
 };
 
 static const std::vector<std::string> g_models = {
-    "default",
-    "beguiling-drafter-2018-08-30",
-    "conjoined-burgers-2018-08-28",
-    "leavened-quisling-2018-08-31",
-    "marathon-prescription-2018-08-29", 
-    "somnolent-hogwash-2018-09-01", 
+    RNNOISE_PLUGIN_MODEL_NAMES
 };
 
 const std::vector<std::string>& RnNoiseCommonPlugin::getAvailableModels() { return g_models; }
 
-void RnNoiseCommonPlugin::init() {
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+RnNoiseCommonPlugin::RnNoiseCommonPlugin(uint32_t channels)
+    : m_channels(channels), m_frameIn(channels), m_frameOut(channels) {
+    // The audio thread waits for the workers, which run at normal priority, so that is only worth it when it saves
+    // enough. The calling thread takes a channel as well.
+    const uint32_t threads = std::min(channels, std::max(std::thread::hardware_concurrency(), 1u));
+    if (channels >= k_minParallelChannels && threads > 1) {
+        m_workers = std::make_unique<WorkerPool>(threads - 1);
+    }
+}
+
+RnNoiseCommonPlugin::~RnNoiseCommonPlugin() = default;
+
+void RnNoiseCommonPlugin::init(uint32_t sampleRate, uint32_t blockSize, bool lowLatency) {
     deinit();
+
+    std::lock_guard<std::mutex> guard(m_stateLock);
+    m_framesPer10ms = lowLatency ? 2 : 1;
+    m_denoiseRate = sampleRate == k_widebandSampleRate ? k_widebandSampleRate : k_denoiseSampleRate;
     createDenoiseState();
+    m_latency = 0;
+    m_primingPending = false;
+    if (sampleRate == m_denoiseRate) {
+        for (auto &channel : m_channels) {
+            channel.inputResampler.reset();
+            channel.outputResampler.reset();
+            channel.inputBuffer.clear();
+            // Room for the priming, so that process() does not allocate for it
+            channel.outputBuffer.clear();
+            channel.outputBuffer.reserve(m_frameSize);
+            channel.vadThreshold = -1.f;
+        }
+        m_parallelBlockSize = m_frameSize;
+
+        if (blockSize != 0) {
+            primeOutput(blockSize);
+        } else {
+            m_latency = static_cast<uint32_t>(m_frameSize);
+            m_primingPending = true;
+        }
+    } else {
+        const uint32_t denoiseRate = k_denoiseSampleRate;
+        const auto resamplerQuality = lowLatency ? Resampler::Quality::lowLatency : Resampler::Quality::standard;
+
+        // Up to a frame of input waits for rnnoise, and the resamplers can each be one sample short. Starting the
+        // output that far behind means it never runs dry, whatever the host block size.
+        const uint32_t frameAtHostRate = (m_frameSize * sampleRate + k_denoiseSampleRate - 1) / k_denoiseSampleRate;
+        for (auto &channel : m_channels) {
+            channel.inputResampler = std::make_unique<Resampler>(sampleRate, denoiseRate, resamplerQuality);
+            channel.outputResampler = std::make_unique<Resampler>(denoiseRate, sampleRate, resamplerQuality);
+            channel.inputBuffer.clear();
+            channel.outputBuffer.assign(frameAtHostRate + 2, 0.f);
+            channel.vadThreshold = -1.f;
+        }
+
+        const Channel &channel = m_channels.front();
+        const double delay = (channel.inputResampler->getLatency() + m_frameSize) * sampleRate / k_denoiseSampleRate
+                             + channel.outputResampler->getLatency();
+        m_latency = static_cast<uint32_t>(channel.outputBuffer.size() + std::lround(delay));
+        m_parallelBlockSize = static_cast<int32_t>(frameAtHostRate);
+    }
+}
+
+void RnNoiseCommonPlugin::primeOutput(uint32_t blockSize) {
+    // After any number of blocks the input can be short of a whole frame by at most the frame size minus the gcd
+    // of the two sizes. Starting the output that far behind means it never runs dry.
+    const uint32_t frameSize = static_cast<uint32_t>(m_frameSize);
+    const uint32_t priming = frameSize - greatestCommonDivisor(blockSize, frameSize);
+    for (auto &channel : m_channels) {
+        channel.outputBuffer.assign(priming, 0.f);
+    }
+    m_latency = frameSize + priming;
+    m_primingPending = false;
 }
 
 void RnNoiseCommonPlugin::deinit() {
     std::lock_guard<std::mutex> guard(m_stateLock);
-    m_denoiseState.reset();
+    m_denoisers.reset();
 }
 
 void RnNoiseCommonPlugin::setModel(const std::string name) {
     if (name != m_model) {
         std::lock_guard<std::mutex> guard(m_stateLock);
         m_model = name;
-        m_denoiseState.reset();
+        m_denoisers.reset();
+    }
+}
+
+void RnNoiseCommonPlugin::setLinked(bool linked) {
+    if (linked != m_linked) {
+        std::lock_guard<std::mutex> guard(m_stateLock);
+        m_linked = linked;
+        m_denoisers.reset();
     }
 }
 
 void RnNoiseCommonPlugin::process(const float *in, float *out, int32_t sampleFrames, float vadThreshold, short vadRelease) {
+    process(&in, &out, sampleFrames, vadThreshold, vadRelease);
+}
+
+void RnNoiseCommonPlugin::process(const float *const *in, float *const *out, int32_t sampleFrames, float vadThreshold,
+                                  short vadRelease) {
     assert(vadThreshold >= 0.f && vadThreshold <= 1.f);
 
     if (sampleFrames == 0) {
         return;
     }
 
-    if (!m_denoiseState) {
+    // setModel() and setLinked() may drop the denoisers from another thread, so they are only looked at under the
+    // lock
+    std::lock_guard<std::mutex> guard(m_stateLock);
+    if (!m_denoisers) {
         createDenoiseState();
     }
 
-    std::lock_guard<std::mutex> guard(m_stateLock);
+    // Without a block size from init() the first block stands in for it
+    if (m_primingPending) {
+        primeOutput(static_cast<uint32_t>(sampleFrames));
+    }
 
-    // Good case, we can copy less data around and rnnoise lib is built for it
-    if (sampleFrames == k_denoiseFrameSize) {
-        m_inputBuffer.resize(sampleFrames);
+    // Every frame passes a zero threshold, so the VAD output and the grace period are not needed at all,
+    // unless the VAD is metered. The gate stays on while the threshold is still ramping down to zero.
+    const bool gateEnabled = vadThreshold > 0.f || m_channels.front().vadThreshold > 0.f;
+    for (auto &state : m_denoisers->states) {
+        rnnoise_set_vad_enabled(state.get(), gateEnabled || m_vadMetering);
+    }
 
-        for (size_t i = 0; i < sampleFrames; i++) {
-            m_inputBuffer[i] = in[i] * std::numeric_limits<short>::max();
-        }
+    // Every channel gets the same block sizes, so their buffers always hold the same amount of samples
+    Channel &first = m_channels.front();
 
-        float vadProbability = rnnoise_process_frame(m_denoiseState.get(), out, &m_inputBuffer[0]);
+    // Good case, rnnoise lib is built for it and works straight from in to out
+    const bool direct = !first.inputResampler && sampleFrames == m_frameSize && first.inputBuffer.empty() &&
+                        first.outputBuffer.empty();
 
-        if (vadProbability >= vadThreshold) {
-            m_remainingGracePeriod = vadRelease;
-        }
+    size_t copiedIntoOutput = static_cast<size_t>(sampleFrames);
 
-        if (m_remainingGracePeriod > 0) {
-            m_remainingGracePeriod--;
-            for (size_t i = 0; i < sampleFrames; i++) {
-                out[i] /= std::numeric_limits<short>::max();
-            }
+    if (m_linked) {
+        if (direct) {
+            std::copy(in, in + m_channels.size(), m_frameIn.begin());
+            std::copy(out, out + m_channels.size(), m_frameOut.begin());
+            denoiseLinkedFrame(vadThreshold, vadRelease, gateEnabled);
         } else {
-            for (size_t i = 0; i < sampleFrames; i++) {
-                out[i] = 0.f;
+            for (size_t c = 0; c < m_channels.size(); c++) {
+                bufferInput(m_channels[c], in[c], sampleFrames);
             }
-        }
 
-    } else {
-        m_inputBuffer.resize(m_inputBuffer.size() + sampleFrames);
+            const size_t framesToProcess = first.inputBuffer.size() / m_frameSize;
+            for (size_t i = 0; i < framesToProcess; i++) {
+                for (size_t c = 0; c < m_channels.size(); c++) {
+                    m_frameOut[c] = &m_channels[c].inputBuffer[i * m_frameSize];
+                    m_frameIn[c] = m_frameOut[c];
+                }
+                denoiseLinkedFrame(vadThreshold, vadRelease, gateEnabled);
+            }
 
-        // From [-1.f,1.f] range to [min short, max short] range which rnnoise lib will understand
-        {
-            float *inputBufferWriteStart = &(*(m_inputBuffer.end() - sampleFrames));
-            for (size_t i = 0; i < sampleFrames; i++) {
-                inputBufferWriteStart[i] = in[i] * std::numeric_limits<short>::max();
+            for (size_t c = 0; c < m_channels.size(); c++) {
+                copiedIntoOutput = drainOutput(m_channels[c], framesToProcess, out[c], sampleFrames);
             }
         }
+    } else {
+        // Unlinked channels share nothing, each one goes all the way through on its own
+        auto processChannel = [&](size_t c) {
+            Channel &channel = m_channels[c];
+            DenoiseState *state = m_denoisers->channelStates[c];
 
-        const size_t framesToProcess = m_inputBuffer.size() / k_denoiseFrameSize;
-        const size_t samplesToProcess = framesToProcess * k_denoiseFrameSize;
-
-        m_outputBuffer.resize(m_outputBuffer.size() + samplesToProcess);
+            if (direct) {
+                float vadProbability = rnnoise_process_frame_float(state, out[c], in[c]);
+                gateFrame(out[c], channel, vadProbability, vadThreshold, vadRelease, gateEnabled);
+                return;
+            }
 
-        // Process input buffer by chunks of k_denoiseFrameSize, put result into out buffer to return into range [-1.f,1.f]
-        {
-            float *outBufferWriteStart = &(*(m_outputBuffer.end() - samplesToProcess));
+            bufferInput(channel, in[c], sampleFrames);
 
+            const size_t framesToProcess = channel.inputBuffer.size() / m_frameSize;
             for (size_t i = 0; i < framesToProcess; i++) {
-                float *currentOutBuffer = &outBufferWriteStart[i * k_denoiseFrameSize];
-                float *currentInBuffer = &m_inputBuffer[i * k_denoiseFrameSize];
-                float vadProbability = rnnoise_process_frame(m_denoiseState.get(), currentOutBuffer, currentInBuffer);
+                float *frame = &channel.inputBuffer[i * m_frameSize];
+                float vadProbability = rnnoise_process_frame_float(state, frame, frame);
+                gateFrame(frame, channel, vadProbability, vadThreshold, vadRelease, gateEnabled);
+            }
 
-                if (vadProbability >= vadThreshold) {
-                    m_remainingGracePeriod = vadRelease;
-                }
+            const size_t copied = drainOutput(channel, framesToProcess, out[c], sampleFrames);
+            if (c == 0) {
+                copiedIntoOutput = copied;
+            }
+        };
 
-                if (m_remainingGracePeriod > 0) {
-                    m_remainingGracePeriod--;
-                    for (size_t j = 0; j < k_denoiseFrameSize; j++) {
-                        currentOutBuffer[j] /= std::numeric_limits<short>::max();
-                    }
-                } else {
-                    for (size_t j = 0; j < k_denoiseFrameSize; j++) {
-                        currentOutBuffer[j] = 0.f;
-                    }
-                }
+        // Waking the workers only pays off when every one of them gets at least a frame to denoise
+        if (m_workers && sampleFrames >= m_parallelBlockSize) {
+            m_workers->run(m_channels.size(), processChannel);
+        } else {
+            for (size_t c = 0; c < m_channels.size(); c++) {
+                processChannel(c);
             }
         }
+    }
+
+    m_latency += static_cast<uint32_t>(sampleFrames - copiedIntoOutput);
 
-        const size_t toCopyIntoOutput = std::min(m_outputBuffer.size(), static_cast<size_t>(sampleFrames));
+    float vadProbability = 0.f;
+    for (const auto &channel : m_channels) {
+        vadProbability = std::max(vadProbability, channel.vadProbability);
+    }
+    m_vadProbability = vadProbability;
+}
 
-        if (toCopyIntoOutput > 0) {
-            std::memcpy(out, &m_outputBuffer[0], toCopyIntoOutput * sizeof(float));
+void RnNoiseCommonPlugin::bufferInput(Channel &channel, const float *in, int32_t sampleFrames) {
+    if (channel.inputResampler) {
+        // To 48 kHz, behind the samples still short of a frame
+        const size_t inputStart = channel.inputBuffer.size();
+        channel.inputBuffer.resize(inputStart + channel.inputResampler->getMaxOutput(sampleFrames));
+        channel.inputBuffer.resize(inputStart + channel.inputResampler->process(in, sampleFrames,
+                                                                                &channel.inputBuffer[inputStart]));
+    } else {
+        channel.inputBuffer.insert(channel.inputBuffer.end(), in, in + sampleFrames);
+    }
+}
 
-            m_inputBuffer.erase(m_inputBuffer.begin(), m_inputBuffer.begin() + samplesToProcess);
-            m_outputBuffer.erase(m_outputBuffer.begin(), m_outputBuffer.begin() + toCopyIntoOutput);
-        }
+size_t RnNoiseCommonPlugin::drainOutput(Channel &channel, size_t framesToProcess, float *out, int32_t sampleFrames) {
+    const size_t samplesToProcess = framesToProcess * m_frameSize;
 
-        if (toCopyIntoOutput < sampleFrames) {
-            std::fill(out + toCopyIntoOutput, out + sampleFrames, 0.f);
-        }
+    if (channel.outputResampler) {
+        // Denoised frames go straight back to the host rate
+        const size_t outputStart = channel.outputBuffer.size();
+        channel.outputBuffer.resize(outputStart + channel.outputResampler->getMaxOutput(samplesToProcess));
+        channel.outputBuffer.resize(outputStart + channel.outputResampler->process(channel.inputBuffer.data(),
+                                                                                   samplesToProcess,
+                                                                                   &channel.outputBuffer[outputStart]));
+    } else {
+        channel.outputBuffer.insert(channel.outputBuffer.end(), channel.inputBuffer.begin(),
+                                    channel.inputBuffer.begin() + samplesToProcess);
+    }
+    channel.inputBuffer.erase(channel.inputBuffer.begin(), channel.inputBuffer.begin() + samplesToProcess);
+
+    const size_t toCopyIntoOutput = std::min(channel.outputBuffer.size(), static_cast<size_t>(sampleFrames));
+    std::copy(channel.outputBuffer.begin(), channel.outputBuffer.begin() + toCopyIntoOutput, out);
+    std::fill(out + toCopyIntoOutput, out + sampleFrames, 0.f);
+    channel.outputBuffer.erase(channel.outputBuffer.begin(), channel.outputBuffer.begin() + toCopyIntoOutput);
+
+    return toCopyIntoOutput;
+}
+
+void RnNoiseCommonPlugin::denoiseLinkedFrame(float vadThreshold, short vadRelease, bool gateEnabled) {
+    float vadProbability = rnnoise_process_frame_linked_float(m_denoisers->states.back().get(),
+                                                              m_denoisers->channelStates.data(),
+                                                              static_cast<int>(m_channels.size()),
+                                                              m_frameOut.data(), m_frameIn.data());
+    // The shared probability keeps every channel's grace period in step
+    for (size_t c = 0; c < m_channels.size(); c++) {
+        gateFrame(m_frameOut[c], m_channels[c], vadProbability, vadThreshold, vadRelease, gateEnabled);
+    }
+}
+
+void RnNoiseCommonPlugin::gateFrame(float *frame, Channel &channel, float vadProbability, float vadThreshold,
+                                    short vadRelease, bool gateEnabled) {
+    channel.vadProbability = vadProbability;
+
+    if (channel.vadThreshold < 0.f) {
+        channel.vadThreshold = vadThreshold;
+    } else {
+        const float step = k_vadThresholdRampPer10ms / m_framesPer10ms;
+        const float change = vadThreshold - channel.vadThreshold;
+        channel.vadThreshold = change > step ? channel.vadThreshold + step
+                             : change < -step ? channel.vadThreshold - step
+                             : vadThreshold;
+    }
+
+    if (!gateEnabled) {
+        return;
+    }
+
+    if (vadProbability >= channel.vadThreshold) {
+        channel.remainingGracePeriod = vadRelease * m_framesPer10ms;
+    }
+
+    if (channel.remainingGracePeriod > 0) {
+        channel.remainingGracePeriod--;
+    } else {
+        std::fill(frame, frame + m_frameSize, 0.f);
     }
 }
 
 void RnNoiseCommonPlugin::createDenoiseState() {
-    std::lock_guard<std::mutex> guard(m_stateLock);
+    m_denoisers = createDenoisers(m_model, m_linked);
+    m_frameSize = m_denoisers->frameSize;
+}
+
+std::unique_ptr<RnNoiseCommonPlugin::Denoisers> RnNoiseCommonPlugin::createDenoisers(const std::string &name,
+                                                                                          bool linked) const {
     RNNModel* model = nullptr;
-    auto it = g_modelsMap.find(m_model);
+    auto it = g_modelsMap.find(name);
     if (it != g_modelsMap.end()) {
         model = rnnoise_get_model(it->second.c_str());
     }
-    m_denoiseState = std::shared_ptr<DenoiseState>(rnnoise_create(model), [](DenoiseState *st) {
-        rnnoise_destroy(st);
-    });
-}
\ No newline at end of file
+
+    auto denoisers = std::make_unique<Denoisers>();
+    denoisers->model = name;
+    denoisers->linked = linked;
+    denoisers->denoiseRate = m_denoiseRate;
+    denoisers->framesPer10ms = m_framesPer10ms;
+
+    const size_t stateCount = linked ? m_channels.size() + 1 : m_channels.size();
+    for (size_t i = 0; i < stateCount; i++) {
+        auto state = std::shared_ptr<DenoiseState>(rnnoise_create(model), [](DenoiseState *st) {
+            rnnoise_destroy(st);
+        });
+        rnnoise_set_sample_rate(state.get(), static_cast<int>(m_denoiseRate));
+        denoisers->frameSize = rnnoise_set_low_latency(state.get(), m_framesPer10ms > 1);
+        if (i < m_channels.size()) {
+            denoisers->channelStates.push_back(state.get());
+        }
+        denoisers->states.push_back(std::move(state));
+    }
+    return denoisers;
+}
+
+bool RnNoiseCommonPlugin::swapDenoisers(std::unique_ptr<Denoisers> &denoisers) {
+    std::lock_guard<std::mutex> guard(m_stateLock);
+    if (!denoisers || denoisers->denoiseRate != m_denoiseRate || denoisers->framesPer10ms != m_framesPer10ms) {
+        return false;
+    }
+
+    m_linked = denoisers->linked;
+
+    // Swapped rather than copied, the name can be too long to be stored without allocating
+    std::swap(m_model, denoisers->model);
+    std::swap(m_denoisers, denoisers);
+    return true;
+}
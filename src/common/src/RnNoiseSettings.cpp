@@ -0,0 +1,98 @@
+#include "common/RnNoiseSettings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "common/RnNoiseCommonPlugin.h"
+
+static const uint8_t k_magic[4] = {'R', 'N', 'N', 'S'};
+
+static void writeUint16(uint8_t *out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void writeUint32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint16_t readUint16(const uint8_t *in) {
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+static uint32_t readUint32(const uint8_t *in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+RnNoiseSettings::Blob RnNoiseSettings::serialize() const {
+    Blob blob{};
+    std::copy(std::begin(k_magic), std::end(k_magic), blob.begin());
+    writeUint16(&blob[4], k_version);
+    writeUint16(&blob[6], static_cast<uint16_t>(k_size));
+
+    uint32_t thresholdBits;
+    std::memcpy(&thresholdBits, &vadThreshold, sizeof(thresholdBits));
+    writeUint32(&blob[8], thresholdBits);
+    writeUint16(&blob[12], static_cast<uint16_t>(std::max<short>(vadRelease, 0)));
+
+    const auto &models = RnNoiseCommonPlugin::getAvailableModels();
+    writeUint32(&blob[16], hashModelName(models[std::min(modelIndex, models.size() - 1)]));
+    writeUint32(&blob[20], flags);
+    return blob;
+}
+
+bool RnNoiseSettings::parse(const void *data, size_t size) {
+    const auto *in = static_cast<const uint8_t *>(data);
+    if (in == nullptr || size < k_size || !std::equal(std::begin(k_magic), std::end(k_magic), in)) {
+        return false;
+    }
+
+    // A newer version is fine as long as it only appended to what this one knows
+    const uint16_t version = readUint16(&in[4]);
+    const uint16_t blobSize = readUint16(&in[6]);
+    if (version < 1 || blobSize < k_size || blobSize > size) {
+        return false;
+    }
+
+    float threshold;
+    const uint32_t thresholdBits = readUint32(&in[8]);
+    std::memcpy(&threshold, &thresholdBits, sizeof(threshold));
+    if (!std::isfinite(threshold)) {
+        return false;
+    }
+
+    vadThreshold = std::max(std::min(threshold, 1.f), 0.f);
+    vadRelease = static_cast<short>(std::min<uint16_t>(readUint16(&in[12]), 100));
+
+    const uint32_t modelHash = readUint32(&in[16]);
+    const auto &models = RnNoiseCommonPlugin::getAvailableModels();
+    const auto it = std::find_if(models.begin(), models.end(), [modelHash](const std::string &name) {
+        return hashModelName(name) == modelHash;
+    });
+    modelIndex = it != models.end() ? static_cast<size_t>(it - models.begin()) : 0;
+
+    flags = readUint32(&in[20]);
+    return true;
+}
+
+uint32_t RnNoiseSettings::hashModelName(const std::string &name) {
+    uint32_t hash = 2166136261u;
+    for (const char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+size_t RnNoiseSettings::findModel(const std::string &name) {
+    const auto &models = RnNoiseCommonPlugin::getAvailableModels();
+    const auto it = std::find(models.begin(), models.end(), name);
+    return it != models.end() ? static_cast<size_t>(it - models.begin()) : 0;
+}
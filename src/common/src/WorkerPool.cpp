@@ -0,0 +1,76 @@
+#include "common/WorkerPool.h"
+
+WorkerPool::WorkerPool(size_t threads) {
+    for (size_t i = 0; i < threads; i++) {
+        m_threads.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(size_t count, TaskFunction function, void *context) {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_task = function;
+        m_context = context;
+        m_count = count;
+        m_next = 0;
+        m_finished = 0;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    takeTasks(function, context, count);
+
+    // A worker that joined late may still hold the task, it has to be done with it before the task goes away.
+    // One that has not joined yet finds no task and goes back to sleep.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this, count] { return m_finished == count && m_activeWorkers == 0; });
+    m_task = nullptr;
+}
+
+void WorkerPool::takeTasks(TaskFunction function, void *context, size_t count) {
+    for (size_t i = m_next++; i < count; i = m_next++) {
+        function(context, i);
+        m_finished++;
+    }
+}
+
+void WorkerPool::work() {
+    uint64_t generation = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+        if (m_stop) {
+            return;
+        }
+
+        generation = m_generation;
+        if (m_task == nullptr) {
+            continue;
+        }
+
+        const TaskFunction function = m_task;
+        void *context = m_context;
+        const size_t count = m_count;
+        m_activeWorkers++;
+        lock.unlock();
+
+        takeTasks(function, context, count);
+
+        lock.lock();
+        m_activeWorkers--;
+        m_done.notify_all();
+    }
+}
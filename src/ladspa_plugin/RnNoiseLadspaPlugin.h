@@ -1,5 +1,7 @@
 #pragma once
 
+#include <utility>
+
 #include "ladspa++.h"
 #include "common/RnNoiseCommonPlugin.h"
 
@@ -17,6 +19,45 @@ namespace port_info_custom {
                     99.f
             }
     };
+
+    constexpr static port_info_t linked_input = {
+            "Link channels",
+            "Run one denoiser on the mix of all channels and apply its gains to each of them",
+            port_types::input | port_types::control,
+            {
+                    port_hints::toggled | port_hints::default_0,
+                    0.f,
+                    1.f
+            }
+    };
+
+    // Hosts recognize the latency output by its name
+    constexpr static port_info_t latency_output = {
+            "latency",
+            "Delay from input to output, in samples",
+            port_types::output | port_types::control,
+            {
+                    port_hints::integer,
+                    0.f,
+                    0.f
+            }
+    };
+
+    constexpr static const char *channel_input_names[] = {
+            "Input 1", "Input 2", "Input 3", "Input 4", "Input 5", "Input 6", "Input 7", "Input 8"
+    };
+
+    constexpr static const char *channel_output_names[] = {
+            "Output 1", "Output 2", "Output 3", "Output 4", "Output 5", "Output 6", "Output 7", "Output 8"
+    };
+
+    constexpr port_info_t channel_input(std::size_t channel) {
+        return {channel_input_names[channel], "Effect's audio input.", port_types::input | port_types::audio, {0, 0, 0}};
+    }
+
+    constexpr port_info_t channel_output(std::size_t channel) {
+        return {channel_output_names[channel], "Effect's audio output.", port_types::output | port_types::audio, {0, 0, 0}};
+    }
 }
 
 struct RnNoiseMono {
@@ -24,6 +65,7 @@ struct RnNoiseMono {
         in_1,
         out_1,
         in_vad_threshold,
+        out_latency,
         size
     };
 
@@ -32,6 +74,7 @@ struct RnNoiseMono {
                     port_info_common::audio_input,
                     port_info_common::audio_output,
                     port_info_custom::vad_threshold_input,
+                    port_info_custom::latency_output,
                     port_info_common::final_port
             };
 
@@ -48,8 +91,9 @@ struct RnNoiseMono {
                     nullptr // implementation data
             };
 
-    RnNoiseMono() {
-        m_rnNoisePlugin.init();
+    explicit RnNoiseMono(sample_rate_t sampleRate) {
+        // LADSPA has no block size before run(), the first block sets the latency
+        m_rnNoisePlugin.init(static_cast<uint32_t>(sampleRate));
     }
 
     ~RnNoiseMono() {
@@ -64,6 +108,9 @@ struct RnNoiseMono {
         float vad_threshold_normalized = std::max(std::min(vad_threshold / 100.f, 0.99f), 0.f);
 
         m_rnNoisePlugin.process(in_buffer.data(), out_buffer.data(), in_buffer.size(), vad_threshold_normalized);
+
+        data &latency = ports.get<port_names::out_latency>();
+        latency = static_cast<data>(m_rnNoisePlugin.getLatency());
     }
 
     RnNoiseCommonPlugin m_rnNoisePlugin;
@@ -76,6 +123,8 @@ struct RnNoiseStereo {
         out_1,
         out_r,
         in_vad_threshold,
+        out_latency,
+        in_linked,
         size
     };
 
@@ -86,6 +135,8 @@ struct RnNoiseStereo {
                     port_info_common::audio_output_l,
                     port_info_common::audio_output_r,
                     port_info_custom::vad_threshold_input,
+                    port_info_custom::latency_output,
+                    port_info_custom::linked_input,
                     port_info_common::final_port
             };
 
@@ -102,14 +153,12 @@ struct RnNoiseStereo {
                     nullptr // implementation data
             };
 
-    RnNoiseStereo() {
-        m_rnNoisePluginL.init();
-        m_rnNoisePluginR.init();
+    explicit RnNoiseStereo(sample_rate_t sampleRate) : m_rnNoisePlugin(2) {
+        m_rnNoisePlugin.init(static_cast<uint32_t>(sampleRate));
     }
 
     ~RnNoiseStereo() {
-        m_rnNoisePluginL.deinit();
-        m_rnNoisePluginR.deinit();
+        m_rnNoisePlugin.deinit();
     }
 
     void run(port_array_t<port_names, port_info> &ports) {
@@ -120,17 +169,142 @@ struct RnNoiseStereo {
         buffer out_buffer_r = ports.get<port_names::out_r>();
 
         uint32_t vad_threshold = ports.get<port_names::in_vad_threshold>();
+        data linked = ports.get<port_names::in_linked>();
+
+        float vad_threshold_normalized = std::max(std::min(vad_threshold / 100.f, 0.99f), 0.f);
+
+        const float *in[] = {in_buffer_l.data(), in_buffer_r.data()};
+        float *out[] = {out_buffer_l.data(), out_buffer_r.data()};
+        m_rnNoisePlugin.setLinked(linked > 0.f);
+        m_rnNoisePlugin.process(in, out, in_buffer_l.size(), vad_threshold_normalized);
+
+        data &latency = ports.get<port_names::out_latency>();
+        latency = static_cast<data>(m_rnNoisePlugin.getLatency());
+    }
+
+    RnNoiseCommonPlugin m_rnNoisePlugin;
+};
+
+/**
+ * Descriptions of the variants with more channels than stereo, for microphone arrays.
+ */
+template<std::size_t Channels>
+struct RnNoiseMultichannelInfo;
+
+template<>
+struct RnNoiseMultichannelInfo<4> {
+    static constexpr info_t info =
+            {
+                    9354884, // unique id
+                    "noise_suppressor_4ch",
+                    properties::realtime,
+                    "Noise Suppressor for Voice (4 channels)",
+                    "werman",
+                    "Removes wide range of noises from voice in real time, based on Xiph's RNNoise library.",
+                    {"voice", "noise suppression", "de-noise"},
+                    strings::copyright::gpl3,
+                    nullptr // implementation data
+            };
+};
+
+template<>
+struct RnNoiseMultichannelInfo<6> {
+    static constexpr info_t info =
+            {
+                    9354886, // unique id
+                    "noise_suppressor_6ch",
+                    properties::realtime,
+                    "Noise Suppressor for Voice (6 channels)",
+                    "werman",
+                    "Removes wide range of noises from voice in real time, based on Xiph's RNNoise library.",
+                    {"voice", "noise suppression", "de-noise"},
+                    strings::copyright::gpl3,
+                    nullptr // implementation data
+            };
+};
+
+template<>
+struct RnNoiseMultichannelInfo<8> {
+    static constexpr info_t info =
+            {
+                    9354888, // unique id
+                    "noise_suppressor_8ch",
+                    properties::realtime,
+                    "Noise Suppressor for Voice (8 channels)",
+                    "werman",
+                    "Removes wide range of noises from voice in real time, based on Xiph's RNNoise library.",
+                    {"voice", "noise suppression", "de-noise"},
+                    strings::copyright::gpl3,
+                    nullptr // implementation data
+            };
+};
+
+/**
+ * The audio ports come first, all the inputs and then all the outputs, followed by the same controls as stereo.
+ */
+template<class ChannelIndices>
+struct RnNoiseMultichannel;
+
+template<std::size_t ...Channel>
+struct RnNoiseMultichannel<std::index_sequence<Channel...>> {
+    static constexpr std::size_t channels = sizeof...(Channel);
+
+    enum class port_names {
+        in_vad_threshold = 2 * channels,
+        out_latency,
+        in_linked,
+        size
+    };
+
+    static constexpr port_info_t port_info[] =
+            {
+                    port_info_custom::channel_input(Channel)...,
+                    port_info_custom::channel_output(Channel)...,
+                    port_info_custom::vad_threshold_input,
+                    port_info_custom::latency_output,
+                    port_info_custom::linked_input,
+                    port_info_common::final_port
+            };
+
+    static constexpr info_t info = RnNoiseMultichannelInfo<channels>::info;
+
+    explicit RnNoiseMultichannel(sample_rate_t sampleRate) : m_rnNoisePlugin(channels) {
+        m_rnNoisePlugin.init(static_cast<uint32_t>(sampleRate));
+    }
+
+    ~RnNoiseMultichannel() {
+        m_rnNoisePlugin.deinit();
+    }
+
+    void run(port_array_t<port_names, port_info> &ports) {
+        const float *in[] = {ports.template get<Channel>().data()...};
+        float *out[] = {ports.template get<channels + Channel>().data()...};
+
+        uint32_t vad_threshold = ports.template get<port_names::in_vad_threshold>();
+        data linked = ports.template get<port_names::in_linked>();
 
         float vad_threshold_normalized = std::max(std::min(vad_threshold / 100.f, 0.99f), 0.f);
 
-        m_rnNoisePluginL.process(in_buffer_l.data(), out_buffer_l.data(), in_buffer_l.size(), vad_threshold_normalized);
-        m_rnNoisePluginR.process(in_buffer_r.data(), out_buffer_r.data(), in_buffer_r.size(), vad_threshold_normalized);
+        m_rnNoisePlugin.setLinked(linked > 0.f);
+        m_rnNoisePlugin.process(in, out, ports.current_sample_count(), vad_threshold_normalized);
+
+        data &latency = ports.template get<port_names::out_latency>();
+        latency = static_cast<data>(m_rnNoisePlugin.getLatency());
     }
 
-    RnNoiseCommonPlugin m_rnNoisePluginL;
-    RnNoiseCommonPlugin m_rnNoisePluginR;
+    RnNoiseCommonPlugin m_rnNoisePlugin;
 };
 
+template<std::size_t ...Channel>
+constexpr port_info_t RnNoiseMultichannel<std::index_sequence<Channel...>>::port_info[];
+
+template<std::size_t ...Channel>
+constexpr info_t RnNoiseMultichannel<std::index_sequence<Channel...>>::info;
+
+using RnNoise4Channels = RnNoiseMultichannel<std::make_index_sequence<4>>;
+using RnNoise6Channels = RnNoiseMultichannel<std::make_index_sequence<6>>;
+using RnNoise8Channels = RnNoiseMultichannel<std::make_index_sequence<8>>;
+
 /*
  * to be called by ladspa
  */
@@ -141,5 +315,6 @@ void _fini() {}
 
 const LADSPA_Descriptor *
 ladspa_descriptor(plugin_index_t index) {
-    return collection<RnNoiseMono, RnNoiseStereo>::get_ladspa_descriptor(index);
+    return collection<RnNoiseMono, RnNoiseStereo, RnNoise4Channels, RnNoise6Channels,
+            RnNoise8Channels>::get_ladspa_descriptor(index);
 }
\ No newline at end of file
@@ -8,12 +8,26 @@ lv2_lib_descriptor(const char *bundle_path,
 
 RnNoiseLib::RnNoiseLib(const char *bundle_path, const LV2_Feature *const *features)
         : Lib(bundle_path, features),
-          m_rnNoisePluginDescriptor("https://github.com/werman/noise-suppression-for-voice") {
+          m_rnNoisePluginDescriptor("https://github.com/werman/noise-suppression-for-voice"),
+          m_rnNoiseStereoDescriptor("https://github.com/werman/noise-suppression-for-voice#stereo"),
+          m_rnNoise4ChannelsDescriptor("https://github.com/werman/noise-suppression-for-voice#4ch"),
+          m_rnNoise6ChannelsDescriptor("https://github.com/werman/noise-suppression-for-voice#6ch"),
+          m_rnNoise8ChannelsDescriptor("https://github.com/werman/noise-suppression-for-voice#8ch") {
 }
 
 const LV2_Descriptor *RnNoiseLib::get_plugin(uint32_t index) {
-    if (index == 0) {
-        return &m_rnNoisePluginDescriptor;
+    switch (index) {
+        case 0:
+            return &m_rnNoisePluginDescriptor;
+        case 1:
+            return &m_rnNoiseStereoDescriptor;
+        case 2:
+            return &m_rnNoise4ChannelsDescriptor;
+        case 3:
+            return &m_rnNoise6ChannelsDescriptor;
+        case 4:
+            return &m_rnNoise8ChannelsDescriptor;
+        default:
+            return nullptr;
     }
-    return nullptr;
 }
@@ -14,6 +14,14 @@ public:
 private:
 
     const lv2::Descriptor<RnNoiseLv2Plugin> m_rnNoisePluginDescriptor;
+
+    /**
+     * Must match LV2_CHANNEL_COUNTS in CMakeLists.txt, which writes their .ttl files.
+     */
+    const lv2::Descriptor<RnNoiseLv2MultichannelPlugin<2>> m_rnNoiseStereoDescriptor;
+    const lv2::Descriptor<RnNoiseLv2MultichannelPlugin<4>> m_rnNoise4ChannelsDescriptor;
+    const lv2::Descriptor<RnNoiseLv2MultichannelPlugin<6>> m_rnNoise6ChannelsDescriptor;
+    const lv2::Descriptor<RnNoiseLv2MultichannelPlugin<8>> m_rnNoise8ChannelsDescriptor;
 };
 
 
@@ -1,12 +1,62 @@
 #include "RnNoiseLv2Plugin.h"
 
-#include "common/RnNoiseCommonPlugin.h"
+#include <algorithm>
+#include <cmath>
+
+#include "common/RnNoiseSettings.h"
+#include "lv2core/buf-size.h"
+#include "lv2core/lv2_util.h"
+#include "lv2core/options.h"
+
+static const char *k_settingsUri = "https://github.com/werman/noise-suppression-for-voice#settings";
+static const char *k_atomChunkUri = "http://lv2plug.in/ns/ext/atom#Chunk";
+static const char *k_atomIntUri = "http://lv2plug.in/ns/ext/atom#Int";
 
 RnNoiseLv2Plugin::RnNoiseLv2Plugin(double sample_rate, const char *bundle_path, const LV2_Feature *const *features,
-                                   bool *valid) : Plugin(sample_rate, bundle_path, features, valid) {
+                                   bool *valid, uint32_t channels) : Plugin(sample_rate, bundle_path, features, valid),
+                                                                     m_channels(channels),
+                                                                     m_inPorts(channels, nullptr),
+                                                                     m_outPorts(channels, nullptr),
+                                                                     m_sampleRate(static_cast<uint32_t>(sample_rate)) {
     (*valid) = true;
 
-    m_rnNoisePlugin = std::make_unique<RnNoiseCommonPlugin>();
+    m_schedule = static_cast<const LV2_Worker_Schedule *>(lv2_features_data(features, LV2_WORKER__schedule));
+
+    const auto *map = static_cast<const LV2_URID_Map *>(lv2_features_data(features, LV2_URID__map));
+    if (map != nullptr) {
+        m_settingsKey = map->map(map->handle, k_settingsUri);
+        m_chunkType = map->map(map->handle, k_atomChunkUri);
+    }
+
+    // The block size decides the latency, the nominal one is what run() gets in practice, the maximum is next best
+    const auto *options = static_cast<const LV2_Options_Option *>(lv2_features_data(features, LV2_OPTIONS__options));
+    if (map != nullptr && options != nullptr) {
+        const LV2_URID nominalBlockLength = map->map(map->handle, LV2_BUF_SIZE__nominalBlockLength);
+        const LV2_URID maxBlockLength = map->map(map->handle, LV2_BUF_SIZE__maxBlockLength);
+        const LV2_URID intType = map->map(map->handle, k_atomIntUri);
+
+        uint32_t maxBlockSize = 0;
+        for (const auto *option = options; option->key != 0; option++) {
+            if (option->context != LV2_OPTIONS_INSTANCE || option->type != intType ||
+                option->size != sizeof(int32_t)) {
+                continue;
+            }
+            const int32_t value = *static_cast<const int32_t *>(option->value);
+            if (value <= 0) {
+                continue;
+            }
+            if (option->key == nominalBlockLength) {
+                m_blockSize = static_cast<uint32_t>(value);
+            } else if (option->key == maxBlockLength) {
+                maxBlockSize = static_cast<uint32_t>(value);
+            }
+        }
+        if (m_blockSize == 0) {
+            m_blockSize = maxBlockSize;
+        }
+    }
+
+    m_rnNoisePlugin = std::make_unique<RnNoiseCommonPlugin>(channels);
 }
 
 
@@ -15,15 +65,36 @@ RnNoiseLv2Plugin::~RnNoiseLv2Plugin() = default;
 void RnNoiseLv2Plugin::connect_port(uint32_t port, void *data_location) {
     PluginBase::connect_port(port, data_location);
 
-    const auto portIdx = static_cast<PortIndex>(port);
+    if (port < m_channels) {
+        m_inPorts[port] = static_cast<const float *>(data_location);
+        return;
+    }
+    if (port < 2 * m_channels) {
+        m_outPorts[port - m_channels] = static_cast<float *>(data_location);
+        return;
+    }
+
+    const auto portIdx = static_cast<ControlPortIndex>(port - 2 * m_channels);
 
     switch (portIdx) {
-        case PortIndex::input: {
-            m_inPort = static_cast<float *>(data_location);
+        case ControlPortIndex::latency: {
+            m_latencyPort = static_cast<float *>(data_location);
+            break;
+        }
+        case ControlPortIndex::vadThreshold: {
+            m_vadThresholdPort = static_cast<const float *>(data_location);
+            break;
+        }
+        case ControlPortIndex::vadRelease: {
+            m_vadReleasePort = static_cast<const float *>(data_location);
+            break;
+        }
+        case ControlPortIndex::model: {
+            m_modelPort = static_cast<const float *>(data_location);
             break;
         }
-        case PortIndex::output: {
-            m_outPort = static_cast<float *>(data_location);
+        case ControlPortIndex::vadProbability: {
+            m_vadProbabilityPort = static_cast<float *>(data_location);
             break;
         }
     }
@@ -32,14 +103,51 @@ void RnNoiseLv2Plugin::connect_port(uint32_t port, void *data_location) {
 void RnNoiseLv2Plugin::activate() {
     PluginBase::activate();
 
-    m_rnNoisePlugin->init();
+    m_rnNoisePlugin->init(m_sampleRate, m_blockSize);
 }
 
 void RnNoiseLv2Plugin::run(uint32_t sample_count) {
     PluginBase::run(sample_count);
 
-    if (m_inPort != nullptr && m_outPort != nullptr) {
-        m_rnNoisePlugin->process(m_inPort, m_outPort, sample_count, 0);
+    // Control ports are plain floats that the host writes between the calls to run()
+    if (m_vadThresholdPort != nullptr) {
+        m_vadThreshold = std::max(std::min(*m_vadThresholdPort / 100.f, 0.99f), 0.f);
+    }
+    const float vadThreshold = m_vadThreshold;
+
+    if (m_vadReleasePort != nullptr) {
+        const float vadReleaseMs = std::max(std::min(*m_vadReleasePort, 1000.f), 0.f);
+        // In 10 ms steps
+        m_vadRelease = static_cast<short>(std::lround(vadReleaseMs / 10.f));
+    }
+    const short vadRelease = m_vadRelease;
+
+    if (m_modelPort != nullptr) {
+        const auto &models = RnNoiseCommonPlugin::getAvailableModels();
+        m_selectedModel = static_cast<size_t>(
+                std::max(std::min(std::lround(*m_modelPort), static_cast<long>(models.size()) - 1), 0L));
+    }
+    // A change while the worker is busy is picked up once it is done
+    const size_t modelIndex = m_selectedModel;
+    const bool linked = m_selectedLinked;
+    if ((modelIndex != m_modelIndex || linked != m_linked) && !m_modelPending) {
+        requestDenoisers(modelIndex, linked);
+    }
+
+    m_rnNoisePlugin->setVadMetering(m_vadProbabilityPort != nullptr);
+
+    const auto isConnected = [](const void *port) { return port != nullptr; };
+    if (std::all_of(m_inPorts.begin(), m_inPorts.end(), isConnected) &&
+        std::all_of(m_outPorts.begin(), m_outPorts.end(), isConnected)) {
+        m_rnNoisePlugin->process(m_inPorts.data(), m_outPorts.data(), sample_count, vadThreshold, vadRelease);
+    }
+
+    if (m_vadProbabilityPort != nullptr) {
+        *m_vadProbabilityPort = m_rnNoisePlugin->getVadProbability();
+    }
+
+    if (m_latencyPort != nullptr) {
+        *m_latencyPort = static_cast<float>(m_rnNoisePlugin->getLatency());
     }
 }
 
@@ -48,3 +156,131 @@ void RnNoiseLv2Plugin::deactivate() {
 
     m_rnNoisePlugin->deinit();
 }
+
+void RnNoiseLv2Plugin::requestDenoisers(size_t modelIndex, bool linked) {
+    m_modelIndex = modelIndex;
+    m_linked = linked;
+
+    if (m_schedule != nullptr) {
+        const WorkerMessage message{WorkerMessage::Type::createDenoisers, modelIndex, linked, nullptr};
+        if (m_schedule->schedule_work(m_schedule->handle, sizeof(message), &message) == LV2_WORKER_SUCCESS) {
+            m_modelPending = true;
+            return;
+        }
+    }
+
+    m_rnNoisePlugin->setModel(RnNoiseCommonPlugin::getAvailableModels()[modelIndex]);
+    m_rnNoisePlugin->setLinked(linked);
+}
+
+void RnNoiseLv2Plugin::retireDenoisers(std::unique_ptr<RnNoiseCommonPlugin::Denoisers> denoisers) {
+    if (!denoisers) {
+        return;
+    }
+
+    const WorkerMessage message{WorkerMessage::Type::destroyDenoisers, 0, false, denoisers.get()};
+    if (m_schedule->schedule_work(m_schedule->handle, sizeof(message), &message) == LV2_WORKER_SUCCESS) {
+        denoisers.release();
+    }
+    // Otherwise the host's queue is full and they are freed here, which is better than leaking them
+}
+
+LV2_Worker_Status RnNoiseLv2Plugin::work(LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle handle,
+                                         uint32_t size, const void *data) {
+    if (size != sizeof(WorkerMessage)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+    const auto &message = *static_cast<const WorkerMessage *>(data);
+
+    switch (message.type) {
+        case WorkerMessage::Type::createDenoisers: {
+            const auto &models = RnNoiseCommonPlugin::getAvailableModels();
+            auto denoisers = m_rnNoisePlugin->createDenoisers(models[message.modelIndex], message.linked);
+
+            const WorkerMessage response{WorkerMessage::Type::denoisersCreated, message.modelIndex, message.linked,
+                                         denoisers.get()};
+            const LV2_Worker_Status status = respond(handle, sizeof(response), &response);
+            if (status == LV2_WORKER_SUCCESS) {
+                denoisers.release();
+            }
+            return status;
+        }
+        case WorkerMessage::Type::destroyDenoisers: {
+            delete message.denoisers;
+            return LV2_WORKER_SUCCESS;
+        }
+        default:
+            return LV2_WORKER_ERR_UNKNOWN;
+    }
+}
+
+LV2_Worker_Status RnNoiseLv2Plugin::work_response(uint32_t size, const void *body) {
+    if (size != sizeof(WorkerMessage)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+    const auto &message = *static_cast<const WorkerMessage *>(body);
+    if (message.type != WorkerMessage::Type::denoisersCreated) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+
+    m_modelPending = false;
+
+    // Either the replaced denoisers come back, or these ones if the plugin was reconfigured in the meantime,
+    // and run() asks again for the model
+    std::unique_ptr<RnNoiseCommonPlugin::Denoisers> denoisers(message.denoisers);
+    if (!m_rnNoisePlugin->swapDenoisers(denoisers)) {
+        m_modelIndex = static_cast<size_t>(-1);
+    }
+    retireDenoisers(std::move(denoisers));
+
+    return LV2_WORKER_SUCCESS;
+}
+
+LV2_State_Status RnNoiseLv2Plugin::save(LV2_State_Store_Function store, LV2_State_Handle handle, uint32_t /*flags*/,
+                                        const LV2_Feature *const * /*features*/) {
+    if (m_settingsKey == 0) {
+        return LV2_STATE_ERR_NO_FEATURE;
+    }
+
+    RnNoiseSettings settings;
+    settings.vadThreshold = m_vadThreshold;
+    settings.vadRelease = m_vadRelease;
+    settings.modelIndex = m_selectedModel;
+    settings.flags = m_selectedLinked ? static_cast<uint32_t>(RnNoiseSettings::linked) : 0u;
+
+    // The host copies the value
+    const auto blob = settings.serialize();
+    return store(handle, m_settingsKey, blob.data(), blob.size(), m_chunkType,
+                 LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+}
+
+LV2_State_Status RnNoiseLv2Plugin::restore(LV2_State_Retrieve_Function retrieve, LV2_State_Handle handle,
+                                           uint32_t /*flags*/, const LV2_Feature *const * /*features*/) {
+    if (m_settingsKey == 0) {
+        return LV2_STATE_ERR_NO_FEATURE;
+    }
+
+    // No value resets to the defaults
+    RnNoiseSettings settings;
+    size_t size = 0;
+    uint32_t type = 0;
+    uint32_t valueFlags = 0;
+    const void *value = retrieve(handle, m_settingsKey, &size, &type, &valueFlags);
+    if (value != nullptr) {
+        if (type != m_chunkType) {
+            return LV2_STATE_ERR_BAD_TYPE;
+        }
+        if (!settings.parse(value, size)) {
+            return LV2_STATE_ERR_UNKNOWN;
+        }
+    }
+
+    m_vadThreshold = std::min(settings.vadThreshold, 0.99f);
+    m_vadRelease = settings.vadRelease;
+    // run() sets the model and linking up, on the worker if there is one, so that the audio thread does not
+    // have to create the denoisers again
+    m_selectedModel = settings.modelIndex;
+    m_selectedLinked = (settings.flags & RnNoiseSettings::linked) != 0;
+
+    return LV2_STATE_SUCCESS;
+}
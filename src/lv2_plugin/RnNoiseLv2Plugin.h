@@ -1,13 +1,26 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <vector>
 #include "lv2core/Plugin.hpp"
+#include "lv2core/State.hpp"
+#include "lv2core/Worker.hpp"
+#include "lv2core/urid.h"
 
-class RnNoiseCommonPlugin;
+#include "common/RnNoiseCommonPlugin.h"
 
-class RnNoiseLv2Plugin : public lv2::Plugin<lv2::NoExtension> {
+/**
+ * With the host's worker, a new model or linking is set up on the worker thread and only swapped in by the audio
+ * thread, which then never allocates or frees rnnoise states. Without it they change in run().
+ *
+ * The settings are also saved with the host's state as an RnNoiseSettings blob, they stand in for the ports
+ * that the host leaves unconnected.
+ */
+class RnNoiseLv2Plugin : public lv2::Plugin<lv2::Worker, lv2::State> {
 public:
-    RnNoiseLv2Plugin(double sample_rate, const char *bundle_path, const LV2_Feature *const *features, bool *valid);
+    RnNoiseLv2Plugin(double sample_rate, const char *bundle_path, const LV2_Feature *const *features, bool *valid,
+                     uint32_t channels = 1);
     ~RnNoiseLv2Plugin();
 
     void connect_port(uint32_t port, void *data_location) override;
@@ -18,18 +31,118 @@ public:
 
     void deactivate() override;
 
+    LV2_Worker_Status work(LV2_Worker_Respond_Function respond, LV2_Worker_Respond_Handle handle, uint32_t size,
+                           const void *data) override;
+
+    LV2_Worker_Status work_response(uint32_t size, const void *body) override;
+
+    LV2_State_Status save(LV2_State_Store_Function store, LV2_State_Handle handle, uint32_t flags,
+                          const LV2_Feature *const *features) override;
+
+    LV2_State_Status restore(LV2_State_Retrieve_Function retrieve, LV2_State_Handle handle, uint32_t flags,
+                             const LV2_Feature *const *features) override;
+
 private:
 
-    enum class PortIndex {
-        input = 0,
-        output,
+    /**
+     * What run() and the worker send each other, copied by the host.
+     */
+    struct WorkerMessage {
+        enum class Type {
+            // To the worker: create the denoisers for modelIndex and linked
+            createDenoisers,
+            // To run(): the denoisers for modelIndex and linked are ready
+            denoisersCreated,
+            // To the worker: free the denoisers that were replaced
+            destroyDenoisers,
+        };
+
+        Type type;
+        size_t modelIndex;
+        bool linked;
+        RnNoiseCommonPlugin::Denoisers *denoisers;
     };
 
-    const float *m_inPort{nullptr};
-    float *m_outPort{nullptr};
+    void requestDenoisers(size_t modelIndex, bool linked);
 
-    std::unique_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
-};
+    /**
+     * Hands denoisers to the worker to be freed there.
+     */
+    void retireDenoisers(std::unique_ptr<RnNoiseCommonPlugin::Denoisers> denoisers);
+
+    /**
+     * The audio ports come first, all the inputs and then all the outputs, the control ports are numbered after them.
+     */
+    enum class ControlPortIndex {
+        latency = 0,
+        vadThreshold,
+        vadRelease,
+        model,
+        vadProbability,
+    };
+
+    /**
+     * Defaults of the ports in rnnoise.ttl, for hosts that leave them unconnected.
+     */
+    static constexpr float k_defaultVadReleaseMs = 200.f;
+
+    uint32_t m_channels;
 
+    std::vector<const float *> m_inPorts;
+    std::vector<float *> m_outPorts;
+    float *m_latencyPort{nullptr};
+    const float *m_vadThresholdPort{nullptr};
+    const float *m_vadReleasePort{nullptr};
+    const float *m_modelPort{nullptr};
+    float *m_vadProbabilityPort{nullptr};
 
+    /**
+     * The settings from the ports, or from the restored state for the ports that are not connected.
+     * save() may read them while run() writes them.
+     */
+    std::atomic<float> m_vadThreshold{0.f};
+    std::atomic<short> m_vadRelease{static_cast<short>(k_defaultVadReleaseMs / 10)};
+    std::atomic<size_t> m_selectedModel{0};
 
+    /**
+     * Only ever set by restore(), there is no port for it.
+     */
+    std::atomic<bool> m_selectedLinked{false};
+
+    /**
+     * Index into RnNoiseCommonPlugin::getAvailableModels() of the model in use, or being set up by the worker,
+     * and the same for the linking.
+     */
+    size_t m_modelIndex{0};
+    bool m_linked{false};
+    bool m_modelPending{false};
+
+    const LV2_Worker_Schedule *m_schedule{nullptr};
+
+    /**
+     * Mapped in the constructor, they stay 0 without the host's urid:map and then no state is saved.
+     */
+    LV2_URID m_settingsKey{0};
+    LV2_URID m_chunkType{0};
+
+    uint32_t m_sampleRate;
+
+    /**
+     * From the host's options, 0 if it gave none and the first run() decides.
+     */
+    uint32_t m_blockSize{0};
+
+    std::unique_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
+};
+
+/**
+ * The same plugin for microphone arrays, under its own URI.
+ */
+template<uint32_t Channels>
+class RnNoiseLv2MultichannelPlugin : public RnNoiseLv2Plugin {
+public:
+    RnNoiseLv2MultichannelPlugin(double sample_rate, const char *bundle_path, const LV2_Feature *const *features,
+                                 bool *valid)
+            : RnNoiseLv2Plugin(sample_rate, bundle_path, features, valid, Channels) {
+    }
+};
@@ -0,0 +1,75 @@
+#ifndef LV2_STATE_HPP
+#define LV2_STATE_HPP
+
+#include <cstring>
+
+#include "lv2core/state.h"
+#include "lv2core/Plugin.hpp"
+
+namespace lv2 {
+
+/**
+   State extension mixin.
+
+   Pass it to the lv2::Plugin template and override save() and restore().
+   extension_data() of the plugin class then returns the state interface.
+   The instance handle is cast to this class, which must therefore be the
+   first base of the plugin, as in any lv2::Plugin.
+*/
+    template<class Super>
+    class State : public Super {
+    public:
+        State(double r, const char* b, const LV2_Feature* const* f, bool* v)
+                : Super(r, b, f, v)
+        {}
+
+        /**
+           Called by the host to save the state, from any thread and possibly
+           while run() is running.
+        */
+        virtual LV2_State_Status save(LV2_State_Store_Function  /*store*/,
+                                      LV2_State_Handle          /*handle*/,
+                                      uint32_t                  /*flags*/,
+                                      const LV2_Feature* const* /*features*/) {
+            return LV2_STATE_SUCCESS;
+        }
+
+        /**
+           Called by the host to restore the state, never while run() is running.
+        */
+        virtual LV2_State_Status restore(LV2_State_Retrieve_Function /*retrieve*/,
+                                         LV2_State_Handle            /*handle*/,
+                                         uint32_t                    /*flags*/,
+                                         const LV2_Feature* const*   /*features*/) {
+            return LV2_STATE_SUCCESS;
+        }
+
+        static const void* extension_data(const char* uri) {
+            static const LV2_State_Interface state = { s_save, s_restore };
+            if (!strcmp(uri, LV2_STATE__interface)) {
+                return &state;
+            }
+            return Super::extension_data(uri);
+        }
+
+    private:
+        static LV2_State_Status s_save(LV2_Handle                instance,
+                                       LV2_State_Store_Function  store,
+                                       LV2_State_Handle          handle,
+                                       uint32_t                  flags,
+                                       const LV2_Feature* const* features) {
+            return reinterpret_cast<State*>(instance)->save(store, handle, flags, features);
+        }
+
+        static LV2_State_Status s_restore(LV2_Handle                  instance,
+                                          LV2_State_Retrieve_Function retrieve,
+                                          LV2_State_Handle            handle,
+                                          uint32_t                    flags,
+                                          const LV2_Feature* const*   features) {
+            return reinterpret_cast<State*>(instance)->restore(retrieve, handle, flags, features);
+        }
+    };
+
+} /* namespace lv2 */
+
+#endif /* LV2_STATE_HPP */
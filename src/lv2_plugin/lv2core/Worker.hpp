@@ -0,0 +1,79 @@
+#ifndef LV2_WORKER_HPP
+#define LV2_WORKER_HPP
+
+#include <cstring>
+
+#include "lv2core/worker.h"
+#include "lv2core/Plugin.hpp"
+
+namespace lv2 {
+
+/**
+   Worker extension mixin.
+
+   Pass it to the lv2::Plugin template and override work() and work_response().
+   extension_data() of the plugin class then returns the worker interface.
+   The instance handle is cast to this class, which must therefore be the
+   first base of the plugin, as in any lv2::Plugin.
+*/
+    template<class Super>
+    class Worker : public Super {
+    public:
+        Worker(double r, const char* b, const LV2_Feature* const* f, bool* v)
+                : Super(r, b, f, v)
+        {}
+
+        /**
+           Called by the host in a non-realtime thread after the plugin asked for
+           it with LV2_Worker_Schedule::schedule_work() in run().
+        */
+        virtual LV2_Worker_Status work(LV2_Worker_Respond_Function /*respond*/,
+                                       LV2_Worker_Respond_Handle   /*handle*/,
+                                       uint32_t                    /*size*/,
+                                       const void*                 /*data*/) {
+            return LV2_WORKER_SUCCESS;
+        }
+
+        /**
+           Called by the host in the run() context with a response of work().
+        */
+        virtual LV2_Worker_Status work_response(uint32_t /*size*/, const void* /*body*/) {
+            return LV2_WORKER_SUCCESS;
+        }
+
+        /**
+           Called by the host after every run(), once all responses are delivered.
+        */
+        virtual LV2_Worker_Status end_run() { return LV2_WORKER_SUCCESS; }
+
+        static const void* extension_data(const char* uri) {
+            static const LV2_Worker_Interface worker = { s_work, s_work_response, s_end_run };
+            if (!strcmp(uri, LV2_WORKER__interface)) {
+                return &worker;
+            }
+            return Super::extension_data(uri);
+        }
+
+    private:
+        static LV2_Worker_Status s_work(LV2_Handle                  instance,
+                                        LV2_Worker_Respond_Function respond,
+                                        LV2_Worker_Respond_Handle   handle,
+                                        uint32_t                    size,
+                                        const void*                 data) {
+            return reinterpret_cast<Worker*>(instance)->work(respond, handle, size, data);
+        }
+
+        static LV2_Worker_Status s_work_response(LV2_Handle  instance,
+                                                 uint32_t    size,
+                                                 const void* body) {
+            return reinterpret_cast<Worker*>(instance)->work_response(size, body);
+        }
+
+        static LV2_Worker_Status s_end_run(LV2_Handle instance) {
+            return reinterpret_cast<Worker*>(instance)->end_run();
+        }
+    };
+
+} /* namespace lv2 */
+
+#endif /* LV2_WORKER_HPP */
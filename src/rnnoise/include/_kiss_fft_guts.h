@@ -49,13 +49,13 @@
 
 
 #define SAMP_MAX 2147483647
-#define TWID_MAX 32767
+#define TWID_MAX 2147483647
 #define TRIG_UPSCALE 1
 
 #define SAMP_MIN -SAMP_MAX
 
 
-#   define S_MUL(a,b) MULT16_32_Q15(b, a)
+#   define S_MUL(a,b) MULT32_32_Q31(b, a)
 
 #   define C_MUL(m,a,b) \
       do{ (m).r = SUB32_ovflw(S_MUL((a).r,(b).r) , S_MUL((a).i,(b).i)); \
@@ -173,10 +173,4 @@
                 (x)->i = KISS_FFT_SIN(phase);\
         }while(0)
 
-#define  kf_cexp2(x,phase) \
-   do{ \
-      (x)->r = TRIG_UPSCALE*celt_cos_norm((phase));\
-      (x)->i = TRIG_UPSCALE*celt_cos_norm((phase)-32768);\
-}while(0)
-
 #endif /* KISS_FFT_GUTS_H */
@@ -53,7 +53,9 @@ extern "C" {
 #include "arch.h"
 
 #  define kiss_fft_scalar opus_int32
-#  define kiss_twiddle_scalar opus_int16
+/* Q31 twiddles: with Q15 ones the FFT noise floor is only about 96 dB below
+   the strongest bin, which swamps the quiet bands of the denoiser. */
+#  define kiss_twiddle_scalar opus_int32
 
 
 #else
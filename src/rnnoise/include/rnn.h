@@ -30,6 +30,7 @@
 #include "rnnoise.h"
 
 #include "opus_types.h"
+#include "arch.h"
 
 #define WEIGHTS_SCALE (1.f/256)
 
@@ -56,20 +57,79 @@ typedef struct {
   int nb_inputs;
   int nb_neurons;
   int activation;
+  /* Weights regrouped by 4 inputs for the VNNI kernel, and their column sums
+     per input block. Only set on the per-state copies made by rnn_init_kernels(). */
+  const rnn_weight *input_weights_vnni;
+  const rnn_weight *recurrent_weights_vnni;
+  const int *input_weights_sum;
+  const int *recurrent_weights_sum;
+  /* Block-sparse copies of the weights, NULL for dense layers. For each group
+     of 8 outputs, *_block_offset gives the range of its 4x8 blocks in
+     *_block_rows (first input of the block) and *_weights_sparse (32 weights
+     per block, input by input). */
+  const int *input_block_offset;
+  const int *input_block_rows;
+  const rnn_weight *input_weights_sparse;
+  const int *recurrent_block_offset;
+  const int *recurrent_block_rows;
+  const rnn_weight *recurrent_weights_sparse;
 } GRULayer;
 
+#define SPARSE_BLOCK_INPUTS 4
+#define SPARSE_BLOCK_OUTPUTS 8
+
 typedef struct RNNState RNNState;
 
+/* Widest stack of feature projections: input_dense and two GRUs */
+#define MAX_FEATURE_COLS (7 * MAX_NEURONS)
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VL__)
+#define RNN_AVX512 1
+#if defined(__AVX512VNNI__)
+#define RNN_AVX512_VNNI 1
+#endif
+#endif
+
 int is_avx2_supported();
 
+int is_avx512_supported();
+
+int is_avx512_vnni_supported();
+
 void compute_dense(const DenseLayer *layer, float *output, const float *input);
 
-void compute_gru(const GRULayer *gru, float *state, const float *input);
+/* Only the first nb_inputs inputs are read. If input_sum is not NULL it holds the
+   bias plus the projection of the remaining inputs for all three gates. */
+void compute_gru(const GRULayer *gru, float *state, const float *input, int nb_inputs, const float *input_sum);
 
 #if defined(__AVX2__)
-void compute_gru_avx2(const GRULayer* gru, float* state, const float* input);
+void compute_dense_avx2(const DenseLayer *layer, float *output, const float *input);
+
+void compute_gru_avx2(const GRULayer* gru, float* state, const float* input, int nb_inputs, const float* input_sum);
 #endif
 
-void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input);
+#if defined(RNN_AVX512)
+void compute_dense_avx512(const DenseLayer *layer, float *output, const float *input);
+
+void compute_gru_avx512(const GRULayer* gru, float* state, const float* input, int nb_inputs, const float* input_sum);
+#endif
+
+#if defined(RNN_AVX512_VNNI)
+void compute_gru_vnni(const GRULayer* gru, float* state, const float* input, int nb_inputs, const float* input_sum);
+#endif
+
+/* Selects the fastest kernels the CPU supports and prepares the layers they need. */
+void rnn_init_kernels(RNNState *rnn);
+
+/* The C kernels on the model's own layers, whatever the CPU supports. The
+   SIMD kernels are checked against them. */
+void rnn_init_generic_kernels(RNNState *rnn);
+
+void rnn_free_kernels(RNNState *rnn);
+
+/* vad may be NULL when the voice activity output is not needed. The VAD GRU
+   still runs since the other layers read its state. With FIXED_POINT the
+   features are Q10 and the gains and VAD Q15. */
+void compute_rnn(RNNState *rnn, opus_val16 *gains, opus_val16 *vad, const opus_val16 *input);
 
 #endif /* RNN_H_ */
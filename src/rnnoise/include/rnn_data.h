@@ -3,6 +3,17 @@
 
 #include "rnn.h"
 
+/* Storage of the recurrent state between frames. The float GRUs compute in
+   float; fp16 and bf16 halve the per-stream state when many run at once. The
+   integer network keeps its Q10 states as they are. */
+#if defined(RNN_INT_NETWORK)
+typedef opus_int16 rnn_state;
+#elif defined(RNN_STATE_FP16) || defined(RNN_STATE_BF16)
+typedef unsigned short rnn_state;
+#else
+typedef float rnn_state;
+#endif
+
 struct RNNModel {
   int input_dense_size;
   const DenseLayer *input_dense;
@@ -25,10 +36,21 @@ struct RNNModel {
 
 struct RNNState {
   const RNNModel *model;
-  float *vad_gru_state;
-  float *noise_gru_state;
-  float *denoise_gru_state;
-  void (*compute_gru_fct)(const GRULayer* gru, float* state, const float* input);
+  rnn_state *vad_gru_state;
+  rnn_state *noise_gru_state;
+  rnn_state *denoise_gru_state;
+  /* The model's GRU layers, or per-state copies carrying kernel-specific layouts */
+  const GRULayer *vad_gru;
+  const GRULayer *noise_gru;
+  const GRULayer *denoise_gru;
+  /* Feature rows of input_dense, noise_gru and denoise_gru side by side, NULL
+     if the model does not have the expected shape */
+  rnn_weight *feature_weights;
+  rnn_weight *feature_bias;
+  int feature_cols;
+  void (*compute_gru_fct)(const GRULayer* gru, float* state, const float* input, int nb_inputs, const float* input_sum);
+  void (*compute_dense_fct)(const DenseLayer *layer, float *output, const float *input);
+  void (*matvec_fct)(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M);
 };
 
 
@@ -58,6 +58,7 @@ RNNOISE_EXPORT int rnnoise_get_size();
 
 /**
  * Return the number of samples processed by rnnoise_process_frame at a time
+ * at the default 48 kHz rate
  */
 RNNOISE_EXPORT int rnnoise_get_frame_size();
 
@@ -89,10 +90,70 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 /**
  * Denoise a frame of samples
  *
- * in and out must be at least rnnoise_get_frame_size() large.
+ * Samples are in the 16-bit range. in and out must be at least
+ * rnnoise_get_frame_size() large and may be the same buffer.
  */
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/**
+ * Denoise a frame of samples in the [-1, 1] range
+ *
+ * Same as rnnoise_process_frame(), with the conversion from and to the 16-bit
+ * range folded into the filtering. Both can be used on the same DenoiseState.
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_float(DenoiseState *st, float *out, const float *in);
+
+/**
+ * Denoise a frame of several linked channels with one network inference
+ *
+ * The features are computed and the network runs on the mean of the
+ * channels, in mix. The resulting gains are applied to each channel, which
+ * keeps its own signal history in channels[i]; the network and VAD state of
+ * those are not used. All states must have the same sample rate and
+ * low-latency setting. Returns the VAD probability of the mix.
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_linked(DenoiseState *mix, DenoiseState *const *channels, int count,
+                                                  float *const *out, const float *const *in);
+
+/**
+ * rnnoise_process_frame_linked() for samples in the [-1, 1] range
+ */
+RNNOISE_EXPORT float rnnoise_process_frame_linked_float(DenoiseState *mix, DenoiseState *const *channels, int count,
+                                                        float *const *out, const float *const *in);
+
+/**
+ * Enable or disable the voice activity detection (enabled by default)
+ *
+ * When disabled, rnnoise_process_frame() skips the VAD output layer and always
+ * returns 1.
+ */
+RNNOISE_EXPORT void rnnoise_set_vad_enabled(DenoiseState *st, int enabled);
+
+/**
+ * Set the sample rate of the audio given to rnnoise_process_frame()
+ *
+ * 48000 (the default) and 16000 are supported. At 16 kHz the frames are
+ * 160 samples long and only the bands below 8 kHz are analyzed, the model
+ * sees them as it sees band-limited 48 kHz audio. Changing the rate clears
+ * the signal history, so call it before processing.
+ *
+ * Returns the new frame size, or -1 if the rate is not supported.
+ */
+RNNOISE_EXPORT int rnnoise_set_sample_rate(DenoiseState *st, int sample_rate);
+
+/**
+ * Enable or disable the low-latency mode (disabled by default)
+ *
+ * The frames given to rnnoise_process_frame() are then 5 ms long instead of
+ * 10 ms, which halves the delay of the overlap-add. The network still runs
+ * on 10 ms frames, on every second call, and the gains of the call in
+ * between are interpolated. Changing the mode clears the signal history, so
+ * call it before processing.
+ *
+ * Returns the new frame size.
+ */
+RNNOISE_EXPORT int rnnoise_set_low_latency(DenoiseState *st, int enabled);
+
 /**
  * Load a model from a file
  *
@@ -0,0 +1,127 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* tanh and sigmoid as one branch-free rational function, in scalar, AVX2 and
+   AVX-512 versions that only differ by FMA rounding. tanh(x) is x*P(x^2)/Q(x^2)
+   with the input clamped to +/-7.905, where the fit reaches 1. Measured
+   absolute error is under 4e-7 (3e-7 with FMA), and NaN inputs give 1. */
+
+#ifndef TANSIG_APPROX_H
+#define TANSIG_APPROX_H
+
+#include "common.h"
+
+#define TANSIG_CLAMP 7.90531110763549805f
+#define TANSIG_A1 4.89352455891786e-03f
+#define TANSIG_A3 6.37261928875436e-04f
+#define TANSIG_A5 1.48572235717979e-05f
+#define TANSIG_A7 5.12229709037114e-08f
+#define TANSIG_A9 -8.60467152213735e-11f
+#define TANSIG_A11 2.00018790482477e-13f
+#define TANSIG_A13 -2.76076847742355e-16f
+#define TANSIG_B0 4.89352518554385e-03f
+#define TANSIG_B2 2.26843463243900e-03f
+#define TANSIG_B4 1.18534705686654e-04f
+#define TANSIG_B6 1.19825839466702e-06f
+
+static OPUS_INLINE float tansig_approx(float x)
+{
+    float x2, p, q;
+    /* Written so that a NaN ends up clamped */
+    x = x < TANSIG_CLAMP ? x : TANSIG_CLAMP;
+    x = x > -TANSIG_CLAMP ? x : -TANSIG_CLAMP;
+    x2 = x * x;
+    p = x2 * TANSIG_A13 + TANSIG_A11;
+    p = x2 * p + TANSIG_A9;
+    p = x2 * p + TANSIG_A7;
+    p = x2 * p + TANSIG_A5;
+    p = x2 * p + TANSIG_A3;
+    p = x2 * p + TANSIG_A1;
+    q = x2 * TANSIG_B6 + TANSIG_B4;
+    q = x2 * q + TANSIG_B2;
+    q = x2 * q + TANSIG_B0;
+    return x * p / q;
+}
+
+static OPUS_INLINE float sigmoid_approx(float x)
+{
+    return .5f + .5f * tansig_approx(.5f * x);
+}
+
+#if defined(__AVX2__)
+#include "vec_avx.h"
+
+static OPUS_INLINE __m256 tansig_approx8(__m256 x)
+{
+    __m256 x2, p, q;
+    x = _mm256_min_ps(x, _mm256_set1_ps(TANSIG_CLAMP));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-TANSIG_CLAMP));
+    x2 = _mm256_mul_ps(x, x);
+    p = _MM256_FMADD_PS(x2, _mm256_set1_ps(TANSIG_A13), _mm256_set1_ps(TANSIG_A11));
+    p = _MM256_FMADD_PS(x2, p, _mm256_set1_ps(TANSIG_A9));
+    p = _MM256_FMADD_PS(x2, p, _mm256_set1_ps(TANSIG_A7));
+    p = _MM256_FMADD_PS(x2, p, _mm256_set1_ps(TANSIG_A5));
+    p = _MM256_FMADD_PS(x2, p, _mm256_set1_ps(TANSIG_A3));
+    p = _MM256_FMADD_PS(x2, p, _mm256_set1_ps(TANSIG_A1));
+    q = _MM256_FMADD_PS(x2, _mm256_set1_ps(TANSIG_B6), _mm256_set1_ps(TANSIG_B4));
+    q = _MM256_FMADD_PS(x2, q, _mm256_set1_ps(TANSIG_B2));
+    q = _MM256_FMADD_PS(x2, q, _mm256_set1_ps(TANSIG_B0));
+    return _mm256_div_ps(_mm256_mul_ps(x, p), q);
+}
+
+static OPUS_INLINE __m256 sigmoid_approx8(__m256 x)
+{
+    const __m256 half = _mm256_set1_ps(.5f);
+    return _MM256_FMADD_PS(half, tansig_approx8(_mm256_mul_ps(half, x)), half);
+}
+#endif
+
+#if defined(__AVX512F__)
+static OPUS_INLINE __m512 tansig_approx16(__m512 x)
+{
+    __m512 x2, p, q;
+    x = _mm512_min_ps(x, _mm512_set1_ps(TANSIG_CLAMP));
+    x = _mm512_max_ps(x, _mm512_set1_ps(-TANSIG_CLAMP));
+    x2 = _mm512_mul_ps(x, x);
+    p = _mm512_fmadd_ps(x2, _mm512_set1_ps(TANSIG_A13), _mm512_set1_ps(TANSIG_A11));
+    p = _mm512_fmadd_ps(x2, p, _mm512_set1_ps(TANSIG_A9));
+    p = _mm512_fmadd_ps(x2, p, _mm512_set1_ps(TANSIG_A7));
+    p = _mm512_fmadd_ps(x2, p, _mm512_set1_ps(TANSIG_A5));
+    p = _mm512_fmadd_ps(x2, p, _mm512_set1_ps(TANSIG_A3));
+    p = _mm512_fmadd_ps(x2, p, _mm512_set1_ps(TANSIG_A1));
+    q = _mm512_fmadd_ps(x2, _mm512_set1_ps(TANSIG_B6), _mm512_set1_ps(TANSIG_B4));
+    q = _mm512_fmadd_ps(x2, q, _mm512_set1_ps(TANSIG_B2));
+    q = _mm512_fmadd_ps(x2, q, _mm512_set1_ps(TANSIG_B0));
+    return _mm512_div_ps(_mm512_mul_ps(x, p), q);
+}
+
+static OPUS_INLINE __m512 sigmoid_approx16(__m512 x)
+{
+    const __m512 half = _mm512_set1_ps(.5f);
+    return _mm512_fmadd_ps(half, tansig_approx16(_mm512_mul_ps(half, x)), half);
+}
+#endif
+
+#endif
@@ -43,3 +43,42 @@ static const float tansig_table[201] = {
 1.000000f, 1.000000f, 1.000000f, 1.000000f, 1.000000f,
 1.000000f,
 };
+
+#ifdef RNN_INT_NETWORK
+/* tanh(i/32) in Q15, for i = 0..256 */
+static const opus_int16 tansig_table_q15[257] = {
+0, 1024, 2045, 3063, 4075, 5079, 6073, 7056,
+8025, 8980, 9919, 10840, 11743, 12625, 13486, 14326,
+15143, 15936, 16706, 17452, 18173, 18870, 19542, 20189,
+20813, 21411, 21986, 22538, 23066, 23571, 24054, 24516,
+24956, 25376, 25776, 26157, 26519, 26864, 27191, 27502,
+27797, 28076, 28341, 28592, 28830, 29055, 29268, 29470,
+29660, 29840, 30010, 30170, 30322, 30465, 30600, 30727,
+30847, 30960, 31067, 31167, 31262, 31351, 31435, 31515,
+31589, 31659, 31726, 31788, 31846, 31901, 31953, 32002,
+32048, 32091, 32132, 32170, 32206, 32240, 32271, 32301,
+32329, 32356, 32381, 32404, 32426, 32447, 32466, 32484,
+32501, 32517, 32532, 32547, 32560, 32573, 32584, 32596,
+32606, 32616, 32625, 32634, 32642, 32649, 32657, 32663,
+32670, 32676, 32681, 32686, 32691, 32696, 32700, 32704,
+32708, 32712, 32715, 32718, 32721, 32724, 32727, 32729,
+32732, 32734, 32736, 32738, 32740, 32741, 32743, 32745,
+32746, 32747, 32749, 32750, 32751, 32752, 32753, 32754,
+32755, 32755, 32756, 32757, 32758, 32758, 32759, 32759,
+32760, 32760, 32761, 32761, 32762, 32762, 32762, 32763,
+32763, 32763, 32764, 32764, 32764, 32764, 32765, 32765,
+32765, 32765, 32765, 32766, 32766, 32766, 32766, 32766,
+32766, 32766, 32766, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767, 32767, 32767, 32767, 32767, 32767, 32767, 32767,
+32767,
+};
+#endif
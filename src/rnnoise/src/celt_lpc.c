@@ -30,6 +30,7 @@
 #include "arch.h"
 #include "common.h"
 #include "pitch.h"
+#include "mathops.h"
 
 void _celt_lpc(
     opus_val16* _lpc, /* out: [0...p-1] LPC coefficients      */
@@ -55,7 +56,11 @@ void _celt_lpc(
             for (j = 0; j < i; j++)
                 rr += MULT32_32_Q31(lpc[j], ac[i - j]);
             rr += SHR32(ac[i + 1], 3);
+#ifdef FIXED_POINT
+            r = -frac_div32(SHL32(rr, 3), error);
+#else
             r = -SHL32(rr, 3) / error;
+#endif
             /*  Update LPC coefficients and total error */
             lpc[i] = SHR32(r, 3);
             for (j = 0; j < (i + 1) >> 1; j++)
@@ -40,8 +40,14 @@
 #include "rnnoise.h"
 #include "pitch.h"
 #include "arch.h"
+#include "mathops.h"
 #include "rnn.h"
 #include "rnn_data.h"
+#include "vec_avx.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
 
 #define FRAME_SIZE_SHIFT 2
 #define FRAME_SIZE (120<<FRAME_SIZE_SHIFT)
@@ -62,11 +68,39 @@
 
 #define NB_FEATURES (NB_BANDS+3*NB_DELTA_CEPS+2)
 
+/* NB_BANDS rounded up to a multiple of 8 */
+#define DCT_STRIDE 24
+
+/* The network was trained on samples in 16-bit range */
+#define FLOAT_SAMPLE_SCALE 32767.f
+
 
 #ifndef TRAINING
 #define TRAINING 0
 #endif
 
+#if TRAINING && defined(FIXED_POINT)
+#error "The training data is dumped from the float analysis"
+#endif
+
+#ifdef FIXED_POINT
+/* Samples and spectra are Q(SIG_SHIFT) in 32 bits, which leaves 8x headroom
+   over the 16-bit range for the high-pass and the pitch filter. Band energies
+   and correlations are Q(ENERGY_SHIFT) in 64 bits, the features Q10 as the
+   integer network reads them, gains and normalized correlations Q15. */
+#define ENERGY_SHIFT 20
+/* The band gains are capped at 128 so that they interpolate in 32 bits */
+#define MAX_GAIN_Q15 ((1<<22)-1)
+/* The VAD probability stays Q15 up to the API */
+#define VAD2FLOAT(x) ((x)*(1.f/Q15ONE))
+#else
+#define VAD2FLOAT(x) (x)
+#endif
+
+
+/* DC-removal high-pass applied to the input, at 48 kHz */
+static const float a_hp[2] = {-1.99599, 0.99600};
+static const float b_hp[2] = {-2, 1};
 
 /* The built-in model, used if no file is given as input */
 extern const struct RNNModel rnnoise_model_orig;
@@ -78,123 +112,528 @@ static const opus_int16 eband5ms[] = {
 };
 
 
+#ifdef FIXED_POINT
+/* The high-pass in the coupled form of init_biquad_block(), Q30, run one
+   sample at a time. in_scale brings the caller's samples to the 16-bit range.
+   An array of one so that it passes around like the float block matrix. */
 typedef struct {
-  int init;
+  opus_val32 re, im, c0, c1;
+  float in_scale;
+} HighPassCoef;
+typedef HighPassCoef HighPass[1];
+typedef const HighPassCoef *hp_coef_t;
+#else
+typedef float HighPass[6][8];
+typedef const float (*hp_coef_t)[8];
+#endif
+
+/* Frame layout at one sample rate and hop. The eband5ms edges are in 200 Hz
+   units and the FFT bins are 200>>band_shift Hz wide. With 10 ms frames the
+   bins are 50 Hz wide at every rate, so only the number of bands that fit
+   below Nyquist changes; the bands above stay at zero energy, as with the
+   band-limited examples the models were trained on. */
+typedef struct {
+  int frame_size;
+  int window_size;
+  int freq_size;
+  int nb_bands;
+  int band_shift;
+  int pitch_min_period;
+  int pitch_max_period;
+  int pitch_frame_size;
+  int pitch_buf_size;
+  /* 48 kHz samples per sample, for the pitch period feature */
+  int decimation;
   kiss_fft_state *kfft;
-  float half_window[FRAME_SIZE];
+  opus_val32 half_window[FRAME_SIZE];
+  /* The high-pass at this rate for biquad_hp(), and the same with the input
+     scaled for samples in [-1, 1] */
+  HighPass hp_block;
+  HighPass hp_block_float;
+} FrameMode;
+
+typedef struct {
+  int init;
+  FrameMode mode48;
+  FrameMode mode16;
+  /* 5 ms hops for the low-latency mode */
+  FrameMode mode48_5ms;
+  FrameMode mode16_5ms;
+#ifdef FIXED_POINT
+  /* Q15, with the sqrt(2/NB_BANDS) scaling folded in */
+  opus_val16 dct_table[NB_BANDS*NB_BANDS];
+#else
   float dct_table[NB_BANDS*NB_BANDS];
+  float dct_scaled[NB_BANDS*DCT_STRIDE];
+  void (*log10_fct)(float *y, const float *x, int N);
+  void (*sqrt_fct)(float *y, const float *x, int N);
+  void (*rsqrt_fct)(float *y, const float *x, int N);
+  void (*dct_fct)(float *out, const float *in, int N);
+#endif
 } CommonState;
 
 struct DenoiseState {
-  float analysis_mem[FRAME_SIZE];
-  float cepstral_mem[CEPS_MEM][NB_BANDS];
+  celt_sig analysis_mem[FRAME_SIZE];
+  opus_val16 cepstral_mem[CEPS_MEM][NB_BANDS];
+  opus_val32 cepstral_dist[CEPS_MEM][CEPS_MEM];
   int memid;
-  float synthesis_mem[FRAME_SIZE];
-  float pitch_buf[PITCH_BUF_SIZE];
-  float pitch_enh_buf[PITCH_BUF_SIZE];
-  float last_gain;
+  celt_sig synthesis_mem[FRAME_SIZE];
+  celt_sig pitch_buf[PITCH_BUF_SIZE];
+  celt_sig pitch_enh_buf[PITCH_BUF_SIZE];
+  opus_val16 last_gain;
   int last_period;
-  float mem_hp_x[2];
-  float lastg[NB_BANDS];
+  opus_val32 mem_hp_x[2];
+  opus_val16 lastg[NB_BANDS];
+  int vad_enabled;
+  /* Frames the features are computed on, as the network was trained */
+  const FrameMode *mode;
+  /* Frames that are synthesized, shorter than mode in the low-latency mode */
+  const FrameMode *hop_mode;
+  int hop_count;
+  celt_sig hop_in[FRAME_SIZE];
+  celt_sig hop_mem[FRAME_SIZE];
+  opus_val16 hop_gain[NB_BANDS];
+  opus_val16 hop_vad;
+  int hop_silence;
   RNNState rnn;
 };
 
-void compute_band_energy(float *bandE, const kiss_fft_cpx *X) {
+#ifdef FIXED_POINT
+/* The triangular band weights are applied as integers, with one division per
+   band edge. Each bin is taken down to Q(ENERGY_SHIFT) before it is weighted,
+   which keeps the sums well inside 64 bits. */
+void compute_band_energy(opus_val64 *bandE, const kiss_fft_cpx *X, const FrameMode *mode) {
+  int i;
+  opus_val64 sum[NB_BANDS] = {0};
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    opus_val64 lo = 0, hi = 0;
+    const kiss_fft_cpx *Xb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    Xb = &X[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      opus_val64 tmp;
+      tmp = ((opus_val64)Xb[j].r*Xb[j].r + (opus_val64)Xb[j].i*Xb[j].i) >> (2*SIG_SHIFT-ENERGY_SHIFT);
+      lo += (band_size-j)*tmp;
+      hi += j*tmp;
+    }
+    sum[i] += lo/band_size;
+    sum[i+1] += hi/band_size;
+  }
+  sum[0] *= 2;
+  sum[mode->nb_bands-1] *= 2;
+  for (i=0;i<NB_BANDS;i++)
+  {
+    bandE[i] = sum[i];
+  }
+}
+
+void compute_band_corr(opus_val64 *bandE, const kiss_fft_cpx *X, const kiss_fft_cpx *P, const FrameMode *mode) {
+  int i;
+  opus_val64 sum[NB_BANDS] = {0};
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    opus_val64 lo = 0, hi = 0;
+    const kiss_fft_cpx *Xb, *Pb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    Xb = &X[eband5ms[i]<<mode->band_shift];
+    Pb = &P[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      opus_val64 tmp;
+      tmp = ((opus_val64)Xb[j].r*Pb[j].r + (opus_val64)Xb[j].i*Pb[j].i) >> (2*SIG_SHIFT-ENERGY_SHIFT);
+      lo += (band_size-j)*tmp;
+      hi += j*tmp;
+    }
+    sum[i] += lo/band_size;
+    sum[i+1] += hi/band_size;
+  }
+  sum[0] *= 2;
+  sum[mode->nb_bands-1] *= 2;
+  for (i=0;i<NB_BANDS;i++)
+  {
+    bandE[i] = sum[i];
+  }
+}
+
+#else
+
+void compute_band_energy(float *bandE, const kiss_fft_cpx *X, const FrameMode *mode) {
   int i;
   float sum[NB_BANDS] = {0};
-  for (i=0;i<NB_BANDS-1;i++)
+  for (i=0;i<mode->nb_bands-1;i++)
   {
     int j;
     int band_size;
-    band_size = (eband5ms[i+1]-eband5ms[i])<<FRAME_SIZE_SHIFT;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
     for (j=0;j<band_size;j++) {
       float tmp;
       float frac = (float)j/band_size;
-      tmp = SQUARE(X[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].r);
-      tmp += SQUARE(X[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].i);
+      tmp = SQUARE(X[(eband5ms[i]<<mode->band_shift) + j].r);
+      tmp += SQUARE(X[(eband5ms[i]<<mode->band_shift) + j].i);
       sum[i] += (1-frac)*tmp;
       sum[i+1] += frac*tmp;
     }
   }
   sum[0] *= 2;
-  sum[NB_BANDS-1] *= 2;
+  sum[mode->nb_bands-1] *= 2;
   for (i=0;i<NB_BANDS;i++)
   {
     bandE[i] = sum[i];
   }
 }
 
-void compute_band_corr(float *bandE, const kiss_fft_cpx *X, const kiss_fft_cpx *P) {
+void compute_band_corr(float *bandE, const kiss_fft_cpx *X, const kiss_fft_cpx *P, const FrameMode *mode) {
   int i;
   float sum[NB_BANDS] = {0};
-  for (i=0;i<NB_BANDS-1;i++)
+  for (i=0;i<mode->nb_bands-1;i++)
   {
     int j;
     int band_size;
-    band_size = (eband5ms[i+1]-eband5ms[i])<<FRAME_SIZE_SHIFT;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
     for (j=0;j<band_size;j++) {
       float tmp;
       float frac = (float)j/band_size;
-      tmp = X[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].r * P[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].r;
-      tmp += X[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].i * P[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j].i;
+      tmp = X[(eband5ms[i]<<mode->band_shift) + j].r * P[(eband5ms[i]<<mode->band_shift) + j].r;
+      tmp += X[(eband5ms[i]<<mode->band_shift) + j].i * P[(eband5ms[i]<<mode->band_shift) + j].i;
       sum[i] += (1-frac)*tmp;
       sum[i+1] += frac*tmp;
     }
   }
   sum[0] *= 2;
-  sum[NB_BANDS-1] *= 2;
+  sum[mode->nb_bands-1] *= 2;
   for (i=0;i<NB_BANDS;i++)
   {
     bandE[i] = sum[i];
   }
 }
 
-void interp_band_gain(float *g, const float *bandE) {
+void interp_band_gain(float *g, const float *bandE, const FrameMode *mode) {
   int i;
   memset(g, 0, FREQ_SIZE);
-  for (i=0;i<NB_BANDS-1;i++)
+  for (i=0;i<mode->nb_bands-1;i++)
   {
     int j;
     int band_size;
-    band_size = (eband5ms[i+1]-eband5ms[i])<<FRAME_SIZE_SHIFT;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
     for (j=0;j<band_size;j++) {
       float frac = (float)j/band_size;
-      g[(eband5ms[i]<<FRAME_SIZE_SHIFT) + j] = (1-frac)*bandE[i] + frac*bandE[i+1];
+      g[(eband5ms[i]<<mode->band_shift) + j] = (1-frac)*bandE[i] + frac*bandE[i+1];
     }
   }
 }
 
+#endif
+
 
 CommonState common;
 
+#ifdef FIXED_POINT
+/* Integer log in base 2 of a positive 64-bit value */
+static OPUS_INLINE int celt_ilog2_64(opus_val64 x) {
+  opus_uint32 hi = (opus_uint32)(x >> 32);
+  return hi ? 31 + EC_ILOG(hi) : EC_ILOG((opus_uint32)x) - 1;
+}
+
+static OPUS_INLINE opus_val32 sat32(opus_val64 x) {
+  return x > 2147483647 ? 2147483647 : x < -2147483647 ? -2147483647 : (opus_val32)x;
+}
+
+/* Rounded integer square root, for x < 2^62 */
+static opus_val32 isqrt64(opus_val64 x) {
+  opus_uint64 v = x;
+  opus_uint64 r = 0;
+  opus_uint64 bit = (opus_uint64)1 << 62;
+  while (bit > v) bit >>= 2;
+  while (bit != 0) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (opus_val32)(r + (v > r));
+}
+
+/* a/b in Qq for a >= 0 and b > 0, saturated to 2^46. Precision is dropped
+   from b rather than a overflowing. */
+static opus_val64 div64(opus_val64 a, opus_val64 b, int q) {
+  const opus_val64 max_val = (opus_val64)1 << 46;
+  int shift;
+  opus_val64 res;
+  if (a <= 0) return 0;
+  shift = IMAX(0, IMIN(q, 61 - celt_ilog2_64(a)));
+  b >>= q - shift;
+  if (b == 0) return max_val;
+  res = (a << shift)/b;
+  return MIN32(res, max_val);
+}
+
+/* log10() of an energy in Q(ENERGY_SHIFT), Q10 */
+static opus_val16 log10_energy(opus_val64 x) {
+  int shift = IMAX(0, celt_ilog2_64(x) - 30);
+  /* celt_log2() reads its input as Q14 */
+  opus_val32 l = celt_log2((opus_val32)(x >> shift)) + SHL32(shift + 14 - ENERGY_SHIFT, DB_SHIFT);
+  return EXTRACT16(MULT16_32_Q15(QCONST16(0.30103f, 15), l));
+}
+
+/* The caller's sample in the 16-bit range, rounded and saturated */
+static OPUS_INLINE opus_val32 float2int16(float x) {
+  x = MAX32(-32768.f, MIN32(32767.f, x));
+  return (opus_val32)lrintf(x);
+}
+
+#else
+
+static void vec_log10(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i<N;i++) y[i] = log10(x[i]);
+}
+
+static void vec_sqrt(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i<N;i++) y[i] = sqrt(x[i]);
+}
+
+static void vec_rsqrt(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i<N;i++) y[i] = 1./sqrt(x[i]);
+}
+
+static void dct_c(float *out, const float *in, int N) {
+  int i;
+  for (i=0;i<N;i++) {
+    int j;
+    float sum = 0;
+    for (j=0;j<NB_BANDS;j++) {
+      sum += in[j] * common.dct_table[j*NB_BANDS + i];
+    }
+    out[i] = sum*sqrt(2./22);
+  }
+}
+
+#if defined(__AVX2__)
+static OPUS_INLINE __m256i tail_mask8(int n) {
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+/* Approximations from vec_avx.h: within ~1e-6 of libm, far below what the
+   8-bit model weights can resolve in the features. */
+static void vec_log10_avx2(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i+8<=N;i+=8) _mm256_storeu_ps(&y[i], log10_approx8(_mm256_loadu_ps(&x[i])));
+  if (i<N) {
+    __m256i mask = tail_mask8(N-i);
+    /* Masked-off lanes read as 0, which only produces garbage in those lanes. */
+    _mm256_maskstore_ps(&y[i], mask, log10_approx8(_mm256_maskload_ps(&x[i], mask)));
+  }
+}
+
+static void vec_sqrt_avx2(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i+8<=N;i+=8) _mm256_storeu_ps(&y[i], _mm256_sqrt_ps(_mm256_loadu_ps(&x[i])));
+  if (i<N) {
+    __m256i mask = tail_mask8(N-i);
+    _mm256_maskstore_ps(&y[i], mask, _mm256_sqrt_ps(_mm256_maskload_ps(&x[i], mask)));
+  }
+}
+
+static void vec_rsqrt_avx2(float *y, const float *x, int N) {
+  int i;
+  for (i=0;i+8<=N;i+=8) _mm256_storeu_ps(&y[i], rsqrt_approx8(_mm256_loadu_ps(&x[i])));
+  if (i<N) {
+    __m256i mask = tail_mask8(N-i);
+    _mm256_maskstore_ps(&y[i], mask, rsqrt_approx8(_mm256_maskload_ps(&x[i], mask)));
+  }
+}
+
+/* Matrix-vector product against the pre-scaled table, padded to 24 outputs
+   so each input is 3 broadcast FMAs. Only the first N outputs are stored. */
+static void dct_avx2(float *out, const float *in, int N) {
+  int i, j;
+  __m256 acc[DCT_STRIDE/8];
+  int nb_chunks = (N + 7) >> 3;
+  for (i=0;i<nb_chunks;i++) acc[i] = _mm256_setzero_ps();
+  for (j=0;j<NB_BANDS;j++) {
+    __m256 in_v = _mm256_broadcast_ss(&in[j]);
+    for (i=0;i<nb_chunks;i++) {
+      acc[i] = _MM256_FMADD_PS(_mm256_loadu_ps(&common.dct_scaled[j*DCT_STRIDE + 8*i]), in_v, acc[i]);
+    }
+  }
+  for (i=0;i<nb_chunks;i++) {
+    if (8*i+8 <= N) _mm256_storeu_ps(&out[8*i], acc[i]);
+    else _mm256_maskstore_ps(&out[8*i], tail_mask8(N - 8*i), acc[i]);
+  }
+}
+#endif
+
+#endif /* FIXED_POINT */
+
+#ifdef FIXED_POINT
+/* The coupled form of init_biquad_block() below, with Q30 coefficients */
+static void init_hp_coef(HighPassCoef *hp, const float *b, const float *a, float in_scale) {
+  double re = -.5*a[0];
+  double im = sqrt(a[1] - re*re);
+  double c0 = b[0] - a[0];
+  double c1 = (b[1] - a[1] + re*c0)/im;
+  hp->re = (opus_val32)floor(.5 + re*(1<<30));
+  hp->im = (opus_val32)floor(.5 + im*(1<<30));
+  hp->c0 = (opus_val32)floor(.5 + c0*(1<<30));
+  hp->c1 = (opus_val32)floor(.5 + c1*(1<<30));
+  hp->in_scale = in_scale;
+}
+
+#else
+
+/* Expands the high-pass over a block of 4 samples. The filter is realized in
+   coupled (rotation) form rather than the transposed direct form of biquad():
+   with the complex poles this close to z=1 the direct-form state is ill
+   conditioned, while the coupled state keeps float rounding negligible.
+   Row m holds the response to the m-th element of (mem[0], mem[1], x[0..3]):
+   columns 0-3 are the 4 outputs and columns 4-5 the state after the block.
+   Requires complex poles, i.e. a[1] > a[0]^2/4. */
+static void init_biquad_block(float coef[6][8], const float *b, const float *a) {
+  int m;
+  double re = -.5*a[0];
+  double im = sqrt(a[1] - re*re);
+  double c0 = b[0] - a[0];
+  double c1 = (b[1] - a[1] + re*c0)/im;
+  for (m=0;m<6;m++) {
+    int k;
+    double s0 = (m==0);
+    double s1 = (m==1);
+    for (k=0;k<4;k++) {
+      double xk = (m==k+2);
+      double yk = xk + c0*s0 + c1*s1;
+      double t0 = re*s0 - im*s1 + xk;
+      double t1 = im*s0 + re*s1;
+      s0 = t0;
+      s1 = t1;
+      coef[m][k] = yk;
+    }
+    coef[m][4] = s0;
+    coef[m][5] = s1;
+    coef[m][6] = coef[m][7] = 0;
+  }
+}
+#endif
+
+/* The a_hp/b_hp high-pass with the same cutoff at 48 kHz/decimation: every
+   pole z of the 48 kHz filter moves to z^decimation, the double zero at DC
+   stays. */
+static void init_hp_block(FrameMode *mode, int decimation) {
+#ifndef FIXED_POINT
+  int i;
+#endif
+  float a[2];
+  double r = sqrt(a_hp[1]);
+  double theta = acos(-.5*a_hp[0]/r);
+  a[0] = -2*pow(r, decimation)*cos(decimation*theta);
+  a[1] = pow(r, 2*decimation);
+#ifdef FIXED_POINT
+  init_hp_coef(mode->hp_block, b_hp, decimation == 1 ? a_hp : a, 1.f);
+  init_hp_coef(mode->hp_block_float, b_hp, decimation == 1 ? a_hp : a, FLOAT_SAMPLE_SCALE);
+#else
+  init_biquad_block(mode->hp_block, b_hp, decimation == 1 ? a_hp : a);
+  for (i=0;i<6;i++) {
+    int k;
+    for (k=0;k<8;k++)
+      mode->hp_block_float[i][k] = i < 2 ? mode->hp_block[i][k] : FLOAT_SAMPLE_SCALE*mode->hp_block[i][k];
+  }
+#endif
+}
+
+/* hops is the number of frames per 10 ms, 1 or 2 */
+static void init_frame_mode(FrameMode *mode, int decimation, int hops) {
+  int i;
+  mode->frame_size = FRAME_SIZE/decimation/hops;
+  mode->window_size = 2*mode->frame_size;
+  mode->freq_size = mode->frame_size + 1;
+  mode->band_shift = FRAME_SIZE_SHIFT - (hops-1);
+  mode->nb_bands = 0;
+  while (mode->nb_bands < NB_BANDS && (eband5ms[mode->nb_bands]<<mode->band_shift) < mode->freq_size)
+    mode->nb_bands++;
+  mode->pitch_min_period = PITCH_MIN_PERIOD/decimation;
+  mode->pitch_max_period = PITCH_MAX_PERIOD/decimation;
+  mode->pitch_frame_size = PITCH_FRAME_SIZE/decimation;
+  mode->pitch_buf_size = PITCH_BUF_SIZE/decimation;
+  mode->decimation = decimation;
+  mode->kfft = opus_fft_alloc_twiddles(mode->window_size, NULL, NULL, NULL, 0);
+  for (i=0;i<mode->frame_size;i++) {
+    double w = sin(.5*M_PI*(i+.5)/mode->frame_size);
+#ifdef FIXED_POINT
+    mode->half_window[i] = (opus_val32)floor(.5 + 2147483647.*sin(.5*M_PI*w*w));
+#else
+    mode->half_window[i] = sin(.5*M_PI*w*w);
+#endif
+  }
+  init_hp_block(mode, decimation);
+}
+
 static void check_init() {
   int i;
   if (common.init) return;
-  common.kfft = opus_fft_alloc_twiddles(2*FRAME_SIZE, NULL, NULL, NULL, 0);
-  for (i=0;i<FRAME_SIZE;i++)
-    common.half_window[i] = sin(.5*M_PI*sin(.5*M_PI*(i+.5)/FRAME_SIZE) * sin(.5*M_PI*(i+.5)/FRAME_SIZE));
+  init_frame_mode(&common.mode48, 1, 1);
+  init_frame_mode(&common.mode16, 3, 1);
+  init_frame_mode(&common.mode48_5ms, 1, 2);
+  init_frame_mode(&common.mode16_5ms, 3, 2);
   for (i=0;i<NB_BANDS;i++) {
     int j;
     for (j=0;j<NB_BANDS;j++) {
+#ifdef FIXED_POINT
+      double c = cos((i+.5)*j*M_PI/NB_BANDS)*sqrt(2./NB_BANDS);
+      if (j==0) c *= sqrt(.5);
+      common.dct_table[i*NB_BANDS + j] = (opus_val16)floor(.5 + 32768*c);
+#else
       common.dct_table[i*NB_BANDS + j] = cos((i+.5)*j*M_PI/NB_BANDS);
       if (j==0) common.dct_table[i*NB_BANDS + j] *= sqrt(.5);
+      common.dct_scaled[i*DCT_STRIDE + j] = common.dct_table[i*NB_BANDS + j]*sqrt(2./NB_BANDS);
+#endif
     }
   }
+#ifndef FIXED_POINT
+  common.log10_fct = &vec_log10;
+  common.sqrt_fct = &vec_sqrt;
+  common.rsqrt_fct = &vec_rsqrt;
+  common.dct_fct = &dct_c;
+#if defined(__AVX2__)
+  if (is_avx2_supported() == 1) {
+    common.log10_fct = &vec_log10_avx2;
+    common.sqrt_fct = &vec_sqrt_avx2;
+    common.rsqrt_fct = &vec_rsqrt_avx2;
+    common.dct_fct = &dct_avx2;
+  }
+#endif
+#endif
   common.init = 1;
 }
 
-static void dct(float *out, const float *in) {
+#ifdef FIXED_POINT
+/* Computes the first N DCT coefficients, Q10 in and out. */
+static void dct(opus_val32 *out, const opus_val16 *in, int N) {
   int i;
   check_init();
-  for (i=0;i<NB_BANDS;i++) {
+  for (i=0;i<N;i++) {
     int j;
-    float sum = 0;
+    opus_val32 sum = 0;
     for (j=0;j<NB_BANDS;j++) {
-      sum += in[j] * common.dct_table[j*NB_BANDS + i];
+      sum = ADD32(sum, SHR32(MULT16_16(in[j], common.dct_table[j*NB_BANDS + i]), 3));
     }
-    out[i] = sum*sqrt(2./22);
+    out[i] = PSHR32(sum, 12);
   }
 }
+#else
+/* Computes the first N DCT coefficients. */
+static void dct(float *out, const float *in, int N) {
+  check_init();
+  common.dct_fct(out, in, N);
+}
+#endif
 
 #if 0
 static void idct(float *out, const float *in) {
@@ -211,47 +650,42 @@ static void idct(float *out, const float *in) {
 }
 #endif
 
-static void forward_transform(kiss_fft_cpx *out, const float *in) {
+static void forward_transform(const FrameMode *mode, kiss_fft_cpx *out, const celt_sig *in) {
   int i;
   kiss_fft_cpx x[WINDOW_SIZE];
   kiss_fft_cpx y[WINDOW_SIZE];
-  check_init();
-  for (i=0;i<WINDOW_SIZE;i++) {
+#ifdef FIXED_POINT
+  /* The FFT scales by 1/N on its input, which would leave quiet frames with
+     only a few bits. Use the headroom up to 2^27 and take it back after. */
+  int shift;
+  opus_val32 maxval = celt_maxabs32(in, mode->window_size);
+  shift = IMAX(0, 27 - celt_ilog2(MAX32(1, maxval)));
+  for (i=0;i<mode->window_size;i++) {
+    x[i].r = SHL32(in[i], shift);
+    x[i].i = 0;
+  }
+  opus_fft(mode->kfft, x, y, 0);
+  for (i=0;i<mode->freq_size;i++) {
+    out[i].r = PSHR32(y[i].r, shift);
+    out[i].i = PSHR32(y[i].i, shift);
+  }
+#else
+  for (i=0;i<mode->window_size;i++) {
     x[i].r = in[i];
     x[i].i = 0;
   }
-  opus_fft(common.kfft, x, y, 0);
-  for (i=0;i<FREQ_SIZE;i++) {
+  opus_fft(mode->kfft, x, y, 0);
+  for (i=0;i<mode->freq_size;i++) {
     out[i] = y[i];
   }
+#endif
 }
 
-static void inverse_transform(float *out, const kiss_fft_cpx *in) {
+static void apply_window(const FrameMode *mode, celt_sig *x) {
   int i;
-  kiss_fft_cpx x[WINDOW_SIZE];
-  kiss_fft_cpx y[WINDOW_SIZE];
-  check_init();
-  for (i=0;i<FREQ_SIZE;i++) {
-    x[i] = in[i];
-  }
-  for (;i<WINDOW_SIZE;i++) {
-    x[i].r = x[WINDOW_SIZE - i].r;
-    x[i].i = -x[WINDOW_SIZE - i].i;
-  }
-  opus_fft(common.kfft, x, y, 0);
-  /* output in reverse order for IFFT. */
-  out[0] = WINDOW_SIZE*y[0].r;
-  for (i=1;i<WINDOW_SIZE;i++) {
-    out[i] = WINDOW_SIZE*y[WINDOW_SIZE - i].r;
-  }
-}
-
-static void apply_window(float *x) {
-  int i;
-  check_init();
-  for (i=0;i<FRAME_SIZE;i++) {
-    x[i] *= common.half_window[i];
-    x[WINDOW_SIZE - 1 - i] *= common.half_window[i];
+  for (i=0;i<mode->frame_size;i++) {
+    x[i] = MULT32_32_Q31(mode->half_window[i], x[i]);
+    x[mode->window_size - 1 - i] = MULT32_32_Q31(mode->half_window[i], x[mode->window_size - 1 - i]);
   }
 }
 
@@ -264,21 +698,19 @@ int rnnoise_get_frame_size() {
 }
 
 int rnnoise_init(DenoiseState *st, RNNModel *model) {
+  check_init();
   memset(st, 0, sizeof(*st));
+  st->vad_enabled = 1;
+  st->mode = &common.mode48;
+  st->hop_mode = &common.mode48;
   if (model)
     st->rnn.model = model;
   else
     st->rnn.model = &rnnoise_model_orig;
-  st->rnn.vad_gru_state = calloc(sizeof(float), st->rnn.model->vad_gru_size);
-  st->rnn.noise_gru_state = calloc(sizeof(float), st->rnn.model->noise_gru_size);
-  st->rnn.denoise_gru_state = calloc(sizeof(float), st->rnn.model->denoise_gru_size);
-  st->rnn.compute_gru_fct = &compute_gru;
-
-#if defined(__AVX2__)
-  if (is_avx2_supported() == 1) {
-      st->rnn.compute_gru_fct = &compute_gru_avx2;
-  }
-#endif
+  st->rnn.vad_gru_state = calloc(sizeof(rnn_state), st->rnn.model->vad_gru_size);
+  st->rnn.noise_gru_state = calloc(sizeof(rnn_state), st->rnn.model->noise_gru_size);
+  st->rnn.denoise_gru_state = calloc(sizeof(rnn_state), st->rnn.model->denoise_gru_size);
+  rnn_init_kernels(&st->rnn);
 
   return 0;
 }
@@ -290,7 +722,53 @@ DenoiseState *rnnoise_create(RNNModel *model) {
   return st;
 }
 
+static int select_mode(DenoiseState *st, const FrameMode *mode, int low_latency) {
+  const FrameMode *hop_mode = mode;
+  if (low_latency)
+    hop_mode = mode == &common.mode48 ? &common.mode48_5ms : &common.mode16_5ms;
+  if (mode != st->mode || hop_mode != st->hop_mode) {
+    /* The signal history is laid out for the old frames, start over */
+    RNN_CLEAR(st->analysis_mem, FRAME_SIZE);
+    RNN_CLEAR(st->synthesis_mem, FRAME_SIZE);
+    RNN_CLEAR(st->pitch_buf, PITCH_BUF_SIZE);
+    RNN_CLEAR(st->pitch_enh_buf, PITCH_BUF_SIZE);
+    RNN_CLEAR(st->mem_hp_x, 2);
+    RNN_CLEAR(st->hop_mem, FRAME_SIZE);
+    RNN_CLEAR(st->hop_gain, NB_BANDS);
+    st->last_gain = 0;
+    st->last_period = 0;
+    st->hop_count = 0;
+    st->hop_vad = 0;
+    st->hop_silence = 1;
+    st->mode = mode;
+    st->hop_mode = hop_mode;
+  }
+  return hop_mode->frame_size;
+}
+
+int rnnoise_set_sample_rate(DenoiseState *st, int sample_rate) {
+  const FrameMode *mode;
+  check_init();
+  if (sample_rate == 48000)
+    mode = &common.mode48;
+  else if (sample_rate == 16000)
+    mode = &common.mode16;
+  else
+    return -1;
+  return select_mode(st, mode, st->hop_mode != st->mode);
+}
+
+int rnnoise_set_low_latency(DenoiseState *st, int enabled) {
+  check_init();
+  return select_mode(st, st->mode, enabled);
+}
+
+void rnnoise_set_vad_enabled(DenoiseState *st, int enabled) {
+  st->vad_enabled = enabled;
+}
+
 void rnnoise_destroy(DenoiseState *st) {
+  rnn_free_kernels(&st->rnn);
   free(st->rnn.vad_gru_state);
   free(st->rnn.noise_gru_state);
   free(st->rnn.denoise_gru_state);
@@ -302,121 +780,254 @@ int lowpass = FREQ_SIZE;
 int band_lp = NB_BANDS;
 #endif
 
-static void frame_analysis(DenoiseState *st, kiss_fft_cpx *X, float *Ex, const float *in) {
+static void frame_analysis(DenoiseState *st, kiss_fft_cpx *X, opus_val64 *Ex, const celt_sig *in) {
   int i;
-  float x[WINDOW_SIZE];
-  RNN_COPY(x, st->analysis_mem, FRAME_SIZE);
-  for (i=0;i<FRAME_SIZE;i++) x[FRAME_SIZE + i] = in[i];
-  RNN_COPY(st->analysis_mem, in, FRAME_SIZE);
-  apply_window(x);
-  forward_transform(X, x);
+  const FrameMode *mode = st->mode;
+  celt_sig x[WINDOW_SIZE];
+  RNN_COPY(x, st->analysis_mem, mode->frame_size);
+  for (i=0;i<mode->frame_size;i++) x[mode->frame_size + i] = in[i];
+  RNN_COPY(st->analysis_mem, in, mode->frame_size);
+  apply_window(mode, x);
+  forward_transform(mode, X, x);
 #if TRAINING
   for (i=lowpass;i<FREQ_SIZE;i++)
     X[i].r = X[i].i = 0;
 #endif
-  compute_band_energy(Ex, X);
+  compute_band_energy(Ex, X, mode);
+}
+
+/* Band correlation of X and P normalized by their energies, Q15 */
+static void compute_band_corr_norm(opus_val16 *Exp, const kiss_fft_cpx *X, const kiss_fft_cpx *P,
+                                   const opus_val64 *Ex, const opus_val64 *Ep, const FrameMode *mode) {
+  int i;
+#ifdef FIXED_POINT
+  opus_val64 Exy[NB_BANDS];
+  compute_band_corr(Exy, X, P, mode);
+  for (i=0;i<NB_BANDS;i++) {
+    /* Each energy is brought below 2^31 so the product fits, the shifts are
+       undone on Exy after the square root. */
+    int sx = IMAX(0, celt_ilog2_64(Ex[i]+1) - 30);
+    int sy = IMAX(0, celt_ilog2_64(Ep[i]+1) - 30);
+    int shift = sx + sy;
+    opus_val64 eps = (opus_val64)QCONST32(.001f, 30) << (2*ENERGY_SHIFT-30);
+    opus_val64 den2 = (Ex[i] >> sx)*(Ep[i] >> sy);
+    opus_val32 den;
+    if (shift & 1) {
+      den2 >>= 1;
+      shift++;
+    }
+    den = MAX32(1, isqrt64(den2 + (eps >> shift)));
+    Exp[i] = EXTRACT16(SATURATE((Exy[i] >> (shift>>1))*32768/den, 32767));
+  }
+#else
+  float tmp[NB_BANDS];
+  compute_band_corr(Exp, X, P, mode);
+  for (i=0;i<NB_BANDS;i++) tmp[i] = .001f+Ex[i]*Ep[i];
+  common.rsqrt_fct(tmp, tmp, NB_BANDS);
+  for (i=0;i<NB_BANDS;i++) Exp[i] *= tmp[i];
+#endif
 }
 
 static int compute_frame_features(DenoiseState *st, kiss_fft_cpx *X, kiss_fft_cpx *P,
-                                  float *Ex, float *Ep, float *Exp, float *features, const float *in) {
-  int i;
-  float E = 0;
-  float *ceps_0, *ceps_1, *ceps_2;
-  float spec_variability = 0;
-  float Ly[NB_BANDS];
-  float p[WINDOW_SIZE];
-  float pitch_buf[PITCH_BUF_SIZE>>1];
+                                  opus_val64 *Ex, opus_val64 *Ep, opus_val16 *Exp, opus_val16 *features,
+                                  const celt_sig *in) {
+  int i;
+  opus_val64 E = 0;
+  opus_val16 *ceps_0, *ceps_1, *ceps_2;
+  opus_val32 spec_variability = 0;
+  opus_val16 Ly[NB_BANDS];
+  opus_val32 ceps[NB_BANDS];
+  celt_sig p[WINDOW_SIZE];
+  opus_val16 pitch_buf[PITCH_BUF_SIZE>>1];
   int pitch_index;
-  float gain;
-  float *(pre[1]);
-  float tmp[NB_BANDS];
-  float follow, logMax;
+  opus_val16 gain;
+  celt_sig *(pre[1]);
+  opus_val16 follow, logMax;
+#ifdef FIXED_POINT
+  opus_val16 corr[NB_BANDS];
+#endif
+  const FrameMode *mode = st->mode;
+  int frame_size = mode->frame_size;
+  int buf_size = mode->pitch_buf_size;
   frame_analysis(st, X, Ex, in);
-  RNN_MOVE(st->pitch_buf, &st->pitch_buf[FRAME_SIZE], PITCH_BUF_SIZE-FRAME_SIZE);
-  RNN_COPY(&st->pitch_buf[PITCH_BUF_SIZE-FRAME_SIZE], in, FRAME_SIZE);
+  RNN_MOVE(st->pitch_buf, &st->pitch_buf[frame_size], buf_size-frame_size);
+  RNN_COPY(&st->pitch_buf[buf_size-frame_size], in, frame_size);
   pre[0] = &st->pitch_buf[0];
-  pitch_downsample(pre, pitch_buf, PITCH_BUF_SIZE, 1);
-  pitch_search(pitch_buf+(PITCH_MAX_PERIOD>>1), pitch_buf, PITCH_FRAME_SIZE,
-               PITCH_MAX_PERIOD-3*PITCH_MIN_PERIOD, &pitch_index);
-  pitch_index = PITCH_MAX_PERIOD-pitch_index;
+  pitch_downsample(pre, pitch_buf, buf_size, 1);
+  pitch_search(pitch_buf+(mode->pitch_max_period>>1), pitch_buf, mode->pitch_frame_size,
+               mode->pitch_max_period-3*mode->pitch_min_period, &pitch_index);
+  pitch_index = mode->pitch_max_period-pitch_index;
 
-  gain = remove_doubling(pitch_buf, PITCH_MAX_PERIOD, PITCH_MIN_PERIOD,
-          PITCH_FRAME_SIZE, &pitch_index, st->last_period, st->last_gain);
+  gain = remove_doubling(pitch_buf, mode->pitch_max_period, mode->pitch_min_period,
+          mode->pitch_frame_size, &pitch_index, st->last_period, st->last_gain);
   st->last_period = pitch_index;
   st->last_gain = gain;
-  for (i=0;i<WINDOW_SIZE;i++)
-    p[i] = st->pitch_buf[PITCH_BUF_SIZE-WINDOW_SIZE-pitch_index+i];
-  apply_window(p);
-  forward_transform(P, p);
-  compute_band_energy(Ep, P);
-  compute_band_corr(Exp, X, P);
-  for (i=0;i<NB_BANDS;i++) Exp[i] = Exp[i]/sqrt(.001+Ex[i]*Ep[i]);
-  dct(tmp, Exp);
-  for (i=0;i<NB_DELTA_CEPS;i++) features[NB_BANDS+2*NB_DELTA_CEPS+i] = tmp[i];
-  features[NB_BANDS+2*NB_DELTA_CEPS] -= 1.3;
-  features[NB_BANDS+2*NB_DELTA_CEPS+1] -= 0.9;
-  features[NB_BANDS+3*NB_DELTA_CEPS] = .01*(pitch_index-300);
-  logMax = -2;
-  follow = -2;
+  for (i=0;i<mode->window_size;i++)
+    p[i] = st->pitch_buf[buf_size-mode->window_size-pitch_index+i];
+  apply_window(mode, p);
+  forward_transform(mode, P, p);
+  compute_band_energy(Ep, P, mode);
+  compute_band_corr_norm(Exp, X, P, Ex, Ep, mode);
+#ifdef FIXED_POINT
+  for (i=0;i<NB_BANDS;i++) corr[i] = PSHR32(Exp[i], 15-10);
+  dct(ceps, corr, NB_DELTA_CEPS);
+#else
+  dct(ceps, Exp, NB_DELTA_CEPS);
+#endif
+  ceps[0] -= QCONST32(1.3, 10);
+  ceps[1] -= QCONST32(0.9, 10);
+  for (i=0;i<NB_DELTA_CEPS;i++) features[NB_BANDS+2*NB_DELTA_CEPS+i] = SATURATE16(ceps[i]);
+#ifdef FIXED_POINT
+  features[NB_BANDS+3*NB_DELTA_CEPS] = PSHR32(MULT16_16(QCONST16(.01f, 20), pitch_index*mode->decimation-300), 10);
+#else
+  features[NB_BANDS+3*NB_DELTA_CEPS] = .01*(pitch_index*mode->decimation-300);
+#endif
+  logMax = -QCONST16(2, 10);
+  follow = -QCONST16(2, 10);
+#ifdef FIXED_POINT
+  for (i=0;i<NB_BANDS;i++) Ly[i] = log10_energy(Ex[i] + QCONST32(1e-2f, ENERGY_SHIFT));
+#else
+  for (i=0;i<NB_BANDS;i++) Ly[i] = 1e-2f+Ex[i];
+  common.log10_fct(Ly, Ly, NB_BANDS);
+#endif
   for (i=0;i<NB_BANDS;i++) {
-    Ly[i] = log10(1e-2+Ex[i]);
-    Ly[i] = MAX16(logMax-7, MAX16(follow-1.5, Ly[i]));
+    Ly[i] = MAX16(logMax-QCONST16(7, 10), MAX16(follow-QCONST16(1.5, 10), Ly[i]));
     logMax = MAX16(logMax, Ly[i]);
-    follow = MAX16(follow-1.5, Ly[i]);
+    follow = MAX16(follow-QCONST16(1.5, 10), Ly[i]);
     E += Ex[i];
   }
-  if (!TRAINING && E < 0.04) {
+  if (!TRAINING && E < QCONST32(0.04, ENERGY_SHIFT)) {
     /* If there's no audio, avoid messing up the state. */
     RNN_CLEAR(features, NB_FEATURES);
     return 1;
   }
-  dct(features, Ly);
-  features[0] -= 12;
-  features[1] -= 4;
+  dct(ceps, Ly, NB_BANDS);
+  ceps[0] -= QCONST32(12, 10);
+  ceps[1] -= QCONST32(4, 10);
+  for (i=0;i<NB_BANDS;i++) features[i] = SATURATE16(ceps[i]);
   ceps_0 = st->cepstral_mem[st->memid];
   ceps_1 = (st->memid < 1) ? st->cepstral_mem[CEPS_MEM+st->memid-1] : st->cepstral_mem[st->memid-1];
   ceps_2 = (st->memid < 2) ? st->cepstral_mem[CEPS_MEM+st->memid-2] : st->cepstral_mem[st->memid-2];
   for (i=0;i<NB_BANDS;i++) ceps_0[i] = features[i];
+  /* Only the row just written changed, so refresh its distances to the other
+     rows. (a-b)^2 and (b-a)^2 round identically, keeping the cached matrix
+     exactly what a full recomputation would give. The fixed-point distance is
+     Q16, from differences saturated symmetrically for the same reason. */
+  for (i=0;i<CEPS_MEM;i++)
+  {
+    int k;
+    opus_val32 dist=0;
+    for (k=0;k<NB_BANDS;k++)
+    {
+      opus_val16 tmp;
+      tmp = EXTRACT16(SATURATE(ceps_0[k] - st->cepstral_mem[i][k], 32767));
+      dist = ADD32(dist, SHR32(MULT16_16(tmp, tmp), 4));
+    }
+    st->cepstral_dist[st->memid][i] = dist;
+    st->cepstral_dist[i][st->memid] = dist;
+  }
   st->memid++;
   for (i=0;i<NB_DELTA_CEPS;i++) {
-    features[i] = ceps_0[i] + ceps_1[i] + ceps_2[i];
-    features[NB_BANDS+i] = ceps_0[i] - ceps_2[i];
-    features[NB_BANDS+NB_DELTA_CEPS+i] =  ceps_0[i] - 2*ceps_1[i] + ceps_2[i];
+    features[i] = SATURATE16(ceps_0[i] + ceps_1[i] + ceps_2[i]);
+    features[NB_BANDS+i] = SATURATE16(ceps_0[i] - ceps_2[i]);
+    features[NB_BANDS+NB_DELTA_CEPS+i] = SATURATE16(ceps_0[i] - 2*ceps_1[i] + ceps_2[i]);
   }
   /* Spectral variability features. */
   if (st->memid == CEPS_MEM) st->memid = 0;
   for (i=0;i<CEPS_MEM;i++)
   {
     int j;
+#ifdef FIXED_POINT
+    opus_val32 mindist = 2147483647;
+#else
     float mindist = 1e15f;
+#endif
     for (j=0;j<CEPS_MEM;j++)
     {
-      int k;
-      float dist=0;
-      for (k=0;k<NB_BANDS;k++)
-      {
-        float tmp;
-        tmp = st->cepstral_mem[i][k] - st->cepstral_mem[j][k];
-        dist += tmp*tmp;
-      }
       if (j!=i)
-        mindist = MIN32(mindist, dist);
+        mindist = MIN32(mindist, st->cepstral_dist[i][j]);
     }
-    spec_variability += mindist;
+    /* In fixed point the division by CEPS_MEM comes first, the Q16 sum could overflow */
+    spec_variability = ADD32(spec_variability, SHR32(mindist, 3));
   }
+#ifdef FIXED_POINT
+  features[NB_BANDS+3*NB_DELTA_CEPS+1] = SATURATE16(PSHR32(spec_variability, 16-10) - QCONST16(2.1f, 10));
+#else
   features[NB_BANDS+3*NB_DELTA_CEPS+1] = spec_variability/CEPS_MEM-2.1;
+#endif
   return TRAINING && E < 0.1;
 }
 
-static void frame_synthesis(DenoiseState *st, float *out, const kiss_fft_cpx *y) {
-  float x[WINDOW_SIZE];
+#ifdef FIXED_POINT
+/* gf is Q15. The forward transform already scaled by 1/N, so the unscaled
+   inverse gives the samples back in Q(SIG_SHIFT), in order. */
+static void frame_synthesis(DenoiseState *st, const FrameMode *mode, float *out, const kiss_fft_cpx *X,
+                            const opus_val32 *gf, float out_scale) {
   int i;
-  inverse_transform(x, y);
-  apply_window(x);
-  for (i=0;i<FRAME_SIZE;i++) out[i] = x[i] + st->synthesis_mem[i];
-  RNN_COPY(st->synthesis_mem, &x[FRAME_SIZE], FRAME_SIZE);
+  int frame_size = mode->frame_size;
+  int window_size = mode->window_size;
+  const opus_val32 *half_window = mode->half_window;
+  float scale = out_scale*(1.f/(1<<SIG_SHIFT));
+  kiss_fft_cpx x[WINDOW_SIZE];
+  kiss_fft_cpx y[WINDOW_SIZE];
+  if (gf) {
+    for (i=0;i<mode->freq_size;i++) {
+      x[i].r = sat32(((opus_val64)X[i].r*gf[i]) >> 15);
+      x[i].i = sat32(((opus_val64)X[i].i*gf[i]) >> 15);
+    }
+  } else {
+    RNN_COPY(x, X, mode->freq_size);
+  }
+  for (i=1;i<frame_size;i++) {
+    x[window_size - i].r = x[i].r;
+    x[window_size - i].i = -x[i].i;
+  }
+  opus_ifft(mode->kfft, x, y, 0);
+  for (i=0;i<frame_size;i++) {
+    out[i] = scale*ADD32(MULT32_32_Q31(half_window[i], y[i].r), st->synthesis_mem[i]);
+  }
+  for (i=0;i<frame_size;i++) {
+    st->synthesis_mem[i] = MULT32_32_Q31(half_window[frame_size - 1 - i], y[frame_size + i].r);
+  }
 }
 
+#else
+
+/* out_scale is applied with the overlap-add, so that synthesis_mem stays in
+   the 16-bit range whatever the output format. */
+static void frame_synthesis(DenoiseState *st, const FrameMode *mode, float *out, const kiss_fft_cpx *X,
+                            const float *gf, float out_scale) {
+  int i;
+  int frame_size = mode->frame_size;
+  int window_size = mode->window_size;
+  const float *half_window = mode->half_window;
+  kiss_fft_cpx x[WINDOW_SIZE];
+  kiss_fft_cpx y[WINDOW_SIZE];
+  /* Apply the gains while building the Hermitian-symmetric spectrum. */
+  if (gf) {
+    for (i=0;i<mode->freq_size;i++) {
+      x[i].r = X[i].r*gf[i];
+      x[i].i = X[i].i*gf[i];
+    }
+  } else {
+    RNN_COPY(x, X, mode->freq_size);
+  }
+  for (i=1;i<frame_size;i++) {
+    x[window_size - i].r = x[i].r;
+    x[window_size - i].i = -x[i].i;
+  }
+  opus_fft(mode->kfft, x, y, 0);
+  /* The IFFT output is read in reverse order, windowed and overlap-added in the same pass. */
+  out[0] = (window_size*y[0].r*half_window[0] + st->synthesis_mem[0])*out_scale;
+  for (i=1;i<frame_size;i++) {
+    out[i] = (window_size*y[window_size - i].r*half_window[i] + st->synthesis_mem[i])*out_scale;
+  }
+  for (i=0;i<frame_size;i++) {
+    st->synthesis_mem[i] = window_size*y[frame_size - i].r*half_window[frame_size - 1 - i];
+  }
+}
+#endif
+
 static void biquad(float *y, float mem[2], const float *x, const float *b, const float *a, int N) {
   int i;
   for (i=0;i<N;i++) {
@@ -429,80 +1040,465 @@ static void biquad(float *y, float mem[2], const float *x, const float *b, const
   }
 }
 
-void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const float *Ep,
-                  const float *Exp, const float *g) {
+#ifdef FIXED_POINT
+/* The high-pass in coupled form, one sample at a time. The input is brought
+   to 16 bits with the in_scale of c. The state is kept 6 bits below
+   Q(SIG_SHIFT) as it reaches a few hundred times the input at DC. */
+#define HP_STATE_SHIFT 6
+static void biquad_hp(celt_sig *y, opus_val32 mem[2], const float *x, int N, hp_coef_t c) {
+  int i;
+  opus_val32 s0 = mem[0];
+  opus_val32 s1 = mem[1];
+  for (i=0;i<N;i++) {
+    opus_val32 xi = float2int16(c->in_scale*x[i]);
+    opus_val32 t0;
+    y[i] = SHL32(xi, SIG_SHIFT)
+         + (opus_val32)(((opus_val64)c->c0*s0 + (opus_val64)c->c1*s1 + (1<<(29-HP_STATE_SHIFT))) >> (30-HP_STATE_SHIFT));
+    t0 = (opus_val32)(((opus_val64)c->re*s0 - (opus_val64)c->im*s1 + (1<<29)) >> 30) + SHL32(xi, SIG_SHIFT-HP_STATE_SHIFT);
+    s1 = (opus_val32)(((opus_val64)c->im*s0 + (opus_val64)c->re*s1 + (1<<29)) >> 30);
+    s0 = t0;
+  }
+  mem[0] = s0;
+  mem[1] = s1;
+}
+
+#else
+
+/* Block-parallel, float-only equivalent of biquad() with the a_hp/b_hp
+   coefficients. Each block of 4 outputs and the next state is a linear map of
+   the current state and inputs, so the serial dependency is one step per block
+   rather than per sample. N must be a multiple of 4, and mem holds the coupled
+   form state of init_biquad_block(), not the biquad() one.
+   Against a double-precision reference this stays around 138 dB SNR, where
+   biquad() (float state, double products) reaches about 80 dB.
+   c is the hp_block of the FrameMode at the input rate, or its hp_block_float
+   to also scale the input. */
+static void biquad_hp(float *y, float mem[2], const float *x, int N, hp_coef_t c) {
+  int i;
+#if defined(__SSE__) || defined(_M_X64)
+  {
+    __m128 s0 = _mm_set1_ps(mem[0]);
+    __m128 s1 = _mm_set1_ps(mem[1]);
+    for (i=0;i<N;i+=4) {
+      __m128 xv = _mm_loadu_ps(&x[i]);
+      __m128 x0 = _mm_shuffle_ps(xv, xv, 0x00);
+      __m128 x1 = _mm_shuffle_ps(xv, xv, 0x55);
+      __m128 x2 = _mm_shuffle_ps(xv, xv, 0xaa);
+      __m128 x3 = _mm_shuffle_ps(xv, xv, 0xff);
+      __m128 yv, sv;
+      yv = _mm_mul_ps(s0, _mm_loadu_ps(&c[0][0]));
+      sv = _mm_mul_ps(s0, _mm_loadu_ps(&c[0][4]));
+      yv = _mm_add_ps(yv, _mm_mul_ps(s1, _mm_loadu_ps(&c[1][0])));
+      sv = _mm_add_ps(sv, _mm_mul_ps(s1, _mm_loadu_ps(&c[1][4])));
+      yv = _mm_add_ps(yv, _mm_mul_ps(x0, _mm_loadu_ps(&c[2][0])));
+      sv = _mm_add_ps(sv, _mm_mul_ps(x0, _mm_loadu_ps(&c[2][4])));
+      yv = _mm_add_ps(yv, _mm_mul_ps(x1, _mm_loadu_ps(&c[3][0])));
+      sv = _mm_add_ps(sv, _mm_mul_ps(x1, _mm_loadu_ps(&c[3][4])));
+      yv = _mm_add_ps(yv, _mm_mul_ps(x2, _mm_loadu_ps(&c[4][0])));
+      sv = _mm_add_ps(sv, _mm_mul_ps(x2, _mm_loadu_ps(&c[4][4])));
+      yv = _mm_add_ps(yv, _mm_mul_ps(x3, _mm_loadu_ps(&c[5][0])));
+      sv = _mm_add_ps(sv, _mm_mul_ps(x3, _mm_loadu_ps(&c[5][4])));
+      _mm_storeu_ps(&y[i], yv);
+      s0 = _mm_shuffle_ps(sv, sv, 0x00);
+      s1 = _mm_shuffle_ps(sv, sv, 0x55);
+    }
+    mem[0] = _mm_cvtss_f32(s0);
+    mem[1] = _mm_cvtss_f32(s1);
+  }
+#else
+  for (i=0;i<N;i+=4) {
+    int k, m;
+    float u[6];
+    float v[6] = {0};
+    u[0] = mem[0];
+    u[1] = mem[1];
+    for (k=0;k<4;k++) u[k+2] = x[i+k];
+    for (m=0;m<6;m++) {
+      for (k=0;k<6;k++) v[k] += u[m]*c[m][k];
+    }
+    for (k=0;k<4;k++) y[i+k] = v[k];
+    mem[0] = v[4];
+    mem[1] = v[5];
+  }
+#endif
+}
+#endif
+
+#ifdef FIXED_POINT
+/* r is Q15 and capped at MAX_GAIN_Q15 */
+static void compute_pitch_gain(opus_val32 *r, const opus_val64 *Ex, const opus_val64 *Ep,
+                               const opus_val16 *Exp, const opus_val16 *g) {
   int i;
-  float r[NB_BANDS];
-  float rf[FREQ_SIZE] = {0};
   for (i=0;i<NB_BANDS;i++) {
-#if 0
-    if (Exp[i]>g[i]) r[i] = 1;
-    else r[i] = Exp[i]*(1-g[i])/(.001 + g[i]*(1-Exp[i]));
-    r[i] = MIN16(1, MAX16(0, r[i]));
+    opus_val32 ri;
+    if (Exp[i]>g[i]) ri = Q15ONE;
+    else {
+      opus_val16 Exp2 = MULT16_16_Q15(Exp[i], Exp[i]);
+      opus_val16 g2 = MULT16_16_Q15(g[i], g[i]);
+      opus_val32 num = MULT16_16_Q15(Exp2, Q15ONE-g2);
+      opus_val32 den = QCONST16(.001f, 15) + MULT16_16_Q15(g2, Q15ONE-Exp2);
+      ri = num >= den ? Q15ONE : DIV32(SHL32(num, 15), den);
+    }
+    /* sqrt(r)*sqrt(Ex/Ep), with a single square root */
+    r[i] = MIN32(MAX_GAIN_Q15, isqrt64(div64(Ex[i], Ep[i]+1, 15)*MAX32(0, ri)));
+  }
+}
+
+/* Adds the pitch prediction to X and computes the band energy of the result in the same pass. */
+static void apply_pitch_gain(kiss_fft_cpx *X, opus_val64 *newE, const kiss_fft_cpx *P, const opus_val32 *r,
+                             const FrameMode *mode) {
+  int i;
+  opus_val64 sum[NB_BANDS] = {0};
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    opus_val64 lo = 0, hi = 0;
+    kiss_fft_cpx *Xb;
+    const kiss_fft_cpx *Pb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    Xb = &X[eband5ms[i]<<mode->band_shift];
+    Pb = &P[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      opus_val64 tmp;
+      opus_val32 rf = (r[i]*(band_size-j) + r[i+1]*j)/band_size;
+      Xb[j].r = sat32(Xb[j].r + (((opus_val64)rf*Pb[j].r) >> 15));
+      Xb[j].i = sat32(Xb[j].i + (((opus_val64)rf*Pb[j].i) >> 15));
+      tmp = ((opus_val64)Xb[j].r*Xb[j].r + (opus_val64)Xb[j].i*Xb[j].i) >> (2*SIG_SHIFT-ENERGY_SHIFT);
+      lo += (band_size-j)*tmp;
+      hi += j*tmp;
+    }
+    sum[i] += lo/band_size;
+    sum[i+1] += hi/band_size;
+  }
+  sum[0] *= 2;
+  sum[mode->nb_bands-1] *= 2;
+  for (i=0;i<NB_BANDS;i++)
+  {
+    newE[i] = sum[i];
+  }
+}
+
+/* Combined per-bin gain: interpolated energy normalization times interpolated denoising gain, Q15.
+   Bins above the last band are zeroed. */
+static void interp_synthesis_gain(const FrameMode *mode, opus_val32 *gf, const opus_val32 *norm, const opus_val16 *g) {
+  int i;
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    opus_val32 *gb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    gb = &gf[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      opus_val32 n = (norm[i]*(band_size-j) + norm[i+1]*j)/band_size;
+      opus_val16 gj = (g[i]*(band_size-j) + g[i+1]*j)/band_size;
+      gb[j] = MULT16_32_Q15(gj, n);
+    }
+  }
+  for (i=eband5ms[mode->nb_bands-1]<<mode->band_shift;i<mode->freq_size;i++) gf[i] = 0;
+}
+
 #else
+
+static void compute_pitch_gain(float *r, const float *Ex, const float *Ep, const float *Exp, const float *g) {
+  int i;
+  for (i=0;i<NB_BANDS;i++) {
     if (Exp[i]>g[i]) r[i] = 1;
-    else r[i] = SQUARE(Exp[i])*(1-SQUARE(g[i]))/(.001 + SQUARE(g[i])*(1-SQUARE(Exp[i])));
-    r[i] = sqrt(MIN16(1, MAX16(0, r[i])));
-#endif
-    r[i] *= sqrt(Ex[i]/(1e-8+Ep[i]));
+    else r[i] = SQUARE(Exp[i])*(1-SQUARE(g[i]))/(.001f + SQUARE(g[i])*(1-SQUARE(Exp[i])));
+    /* sqrt(r)*sqrt(Ex/Ep), with a single square root */
+    r[i] = MIN16(1, MAX16(0, r[i]))*Ex[i]/(1e-8f+Ep[i]);
   }
-  interp_band_gain(rf, r);
-  for (i=0;i<FREQ_SIZE;i++) {
-    X[i].r += rf[i]*P[i].r;
-    X[i].i += rf[i]*P[i].i;
+  common.sqrt_fct(r, r, NB_BANDS);
+}
+
+/* Adds the pitch prediction to X and computes the band energy of the result in the same pass. */
+static void apply_pitch_gain(kiss_fft_cpx *X, float *newE, const kiss_fft_cpx *P, const float *r, const FrameMode *mode) {
+  int i;
+  float sum[NB_BANDS] = {0};
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    kiss_fft_cpx *Xb;
+    const kiss_fft_cpx *Pb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    Xb = &X[eband5ms[i]<<mode->band_shift];
+    Pb = &P[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      float tmp;
+      float frac = (float)j/band_size;
+      float rf = (1-frac)*r[i] + frac*r[i+1];
+      Xb[j].r += rf*Pb[j].r;
+      Xb[j].i += rf*Pb[j].i;
+      tmp = SQUARE(Xb[j].r);
+      tmp += SQUARE(Xb[j].i);
+      sum[i] += (1-frac)*tmp;
+      sum[i+1] += frac*tmp;
+    }
+  }
+  sum[0] *= 2;
+  sum[mode->nb_bands-1] *= 2;
+  for (i=0;i<NB_BANDS;i++)
+  {
+    newE[i] = sum[i];
   }
+}
+
+/* Combined per-bin gain: interpolated energy normalization times interpolated denoising gain.
+   Bins above the last band are zeroed, as interp_band_gain() leaves them. */
+static void interp_synthesis_gain(const FrameMode *mode, float *gf, const float *norm, const float *g) {
+  int i;
+  for (i=0;i<mode->nb_bands-1;i++)
+  {
+    int j;
+    int band_size;
+    float *gb;
+    band_size = (eband5ms[i+1]-eband5ms[i])<<mode->band_shift;
+    gb = &gf[eband5ms[i]<<mode->band_shift];
+    for (j=0;j<band_size;j++) {
+      float frac = (float)j/band_size;
+      gb[j] = ((1-frac)*norm[i] + frac*norm[i+1])*((1-frac)*g[i] + frac*g[i+1]);
+    }
+  }
+  for (i=eband5ms[mode->nb_bands-1]<<mode->band_shift;i<mode->freq_size;i++) gf[i] = 0;
+}
+
+#endif
+
+/* Gains that bring the band energies back to Ex after the pitch filter */
+static void compute_energy_norm(opus_val32 *norm, const opus_val64 *Ex, const opus_val64 *newE) {
+  int i;
+#ifdef FIXED_POINT
+  for (i=0;i<NB_BANDS;i++) norm[i] = MIN32(MAX_GAIN_Q15, isqrt64(div64(Ex[i], newE[i]+1, 30)));
+#else
+  for (i=0;i<NB_BANDS;i++) norm[i] = Ex[i]/(1e-8f+newE[i]);
+  common.sqrt_fct(norm, norm, NB_BANDS);
+#endif
+}
+
+#ifndef FIXED_POINT
+void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const float *Ep,
+                  const float *Exp, const float *g) {
+  int i;
+  float r[NB_BANDS];
   float newE[NB_BANDS];
-  compute_band_energy(newE, X);
   float norm[NB_BANDS];
   float normf[FREQ_SIZE]={0};
-  for (i=0;i<NB_BANDS;i++) {
-    norm[i] = sqrt(Ex[i]/(1e-8+newE[i]));
-  }
-  interp_band_gain(normf, norm);
+  compute_pitch_gain(r, Ex, Ep, Exp, g);
+  apply_pitch_gain(X, newE, P, r, &common.mode48);
+  compute_energy_norm(norm, Ex, newE);
+  interp_band_gain(normf, norm, &common.mode48);
   for (i=0;i<FREQ_SIZE;i++) {
     X[i].r *= normf[i];
     X[i].i *= normf[i];
   }
 }
+#endif
+
+/* The spectrum of the last two hops, x is the new one */
+static void hop_analysis(DenoiseState *st, const FrameMode *mode, kiss_fft_cpx *X, opus_val64 *Ex, const celt_sig *x) {
+  int hop = mode->frame_size;
+  celt_sig w[WINDOW_SIZE];
+  RNN_COPY(w, st->hop_mem, hop);
+  RNN_COPY(&w[hop], x, hop);
+  RNN_COPY(st->hop_mem, x, hop);
+  apply_window(mode, w);
+  forward_transform(mode, X, w);
+  compute_band_energy(Ex, X, mode);
+}
+
+/* Counts the hop that was just added to st->hop_in and, once they make up a
+   whole frame, computes its features and runs the network. In the
+   low-latency mode that hop gets the mean of the previous and the new gains,
+   and the next one the new gains. */
+static void hop_gains(DenoiseState *st, opus_val16 *g) {
+  int i;
+  kiss_fft_cpx X[FREQ_SIZE];
+  kiss_fft_cpx P[WINDOW_SIZE];
+  opus_val64 Ex[NB_BANDS], Ep[NB_BANDS];
+  opus_val16 Exp[NB_BANDS];
+  opus_val16 features[NB_FEATURES];
+  int was_silent = st->hop_silence;
+  if (++st->hop_count*st->hop_mode->frame_size < st->mode->frame_size) {
+    RNN_COPY(g, st->hop_gain, NB_BANDS);
+    return;
+  }
+  st->hop_count = 0;
+  st->hop_vad = st->vad_enabled ? 0 : Q15ONE;
+  st->hop_silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, st->hop_in);
+  if (st->hop_silence) return;
+  compute_rnn(&st->rnn, g, st->vad_enabled ? &st->hop_vad : NULL, features);
+  for (i=0;i<NB_BANDS;i++) {
+    opus_val16 alpha = QCONST16(.6f, 15);
+    g[i] = MAX16(g[i], MULT16_16_Q15(alpha, st->lastg[i]));
+    st->lastg[i] = g[i];
+  }
+  for (i=0;i<NB_BANDS;i++) {
+    opus_val16 prev = was_silent || st->hop_mode == st->mode ? g[i] : st->hop_gain[i];
+    st->hop_gain[i] = g[i];
+    g[i] = HALF32(ADD32(prev, g[i]));
+  }
+}
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+/* Pitch filter and synthesis of a hop with the gains g. hist ends with the
+   newest sample and the filter looks one period back in it. */
+static void hop_synthesis(DenoiseState *st, const FrameMode *mode, float *out, kiss_fft_cpx *X, const opus_val64 *Ex,
+                          const celt_sig *hist, int hist_len, int period, const opus_val16 *g, float out_scale) {
+  int i;
+  kiss_fft_cpx P[WINDOW_SIZE];
+  celt_sig p[WINDOW_SIZE];
+  opus_val64 Ep[NB_BANDS];
+  opus_val16 Exp[NB_BANDS];
+  opus_val32 r[NB_BANDS];
+  opus_val64 newE[NB_BANDS];
+  opus_val32 norm[NB_BANDS];
+  opus_val32 gf[FREQ_SIZE];
+  for (i=0;i<mode->window_size;i++)
+    p[i] = hist[hist_len-mode->window_size-period+i];
+  apply_window(mode, p);
+  forward_transform(mode, P, p);
+  compute_band_energy(Ep, P, mode);
+  compute_band_corr_norm(Exp, X, P, Ex, Ep, mode);
+
+  compute_pitch_gain(r, Ex, Ep, Exp, g);
+  apply_pitch_gain(X, newE, P, r, mode);
+  compute_energy_norm(norm, Ex, newE);
+  interp_synthesis_gain(mode, gf, norm, g);
+  frame_synthesis(st, mode, out, X, gf, out_scale);
+}
+
+/* Low-latency mode: the signal is analyzed and synthesized in hops of half a
+   frame, while the features and the network still see whole frames, as they
+   were trained. */
+static opus_val16 process_hop(DenoiseState *st, float *out, const float *in,
+                              hp_coef_t hp_coef, float out_scale) {
+  const FrameMode *mode = st->hop_mode;
+  int hop = mode->frame_size;
+  kiss_fft_cpx X[FREQ_SIZE];
+  celt_sig x[FRAME_SIZE];
+  celt_sig hist[PITCH_BUF_SIZE+FRAME_SIZE];
+  opus_val64 Ex[NB_BANDS];
+  opus_val16 g[NB_BANDS];
+  int hist_len;
+  biquad_hp(x, st->mem_hp_x, in, hop, hp_coef);
+  RNN_COPY(&st->hop_in[st->hop_count*hop], x, hop);
+  hop_analysis(st, mode, X, Ex, x);
+  hop_gains(st, g);
+  if (st->hop_silence) {
+    frame_synthesis(st, mode, out, X, NULL, out_scale);
+    return st->hop_vad;
+  }
+  /* pitch_buf has whole frames, the hops since the last one follow it */
+  hist_len = st->mode->pitch_buf_size;
+  RNN_COPY(hist, st->pitch_buf, hist_len);
+  RNN_COPY(&hist[hist_len], st->hop_in, st->hop_count*hop);
+  hist_len += st->hop_count*hop;
+  hop_synthesis(st, mode, out, X, Ex, hist, hist_len, st->last_period, g, out_scale);
+  return st->hop_vad;
+}
+
+/* Linked channels: the features and the network run once, on the mean of the
+   channels, in mix. Each channel applies the same band gains to its own
+   spectrum, with its own pitch filter at the period found on the mix. */
+static opus_val16 process_linked(DenoiseState *mix, DenoiseState *const *channels, int count,
+                                 float *const *out, const float *const *in,
+                                 hp_coef_t hp_coef, float out_scale) {
+  int i, c;
+  const FrameMode *mode = mix->hop_mode;
+  int hop = mode->frame_size;
+  celt_sig *mix_in = &mix->hop_in[mix->hop_count*hop];
+  opus_val16 g[NB_BANDS];
+  for (c=0;c<count;c++)
+    biquad_hp(channels[c]->hop_in, channels[c]->mem_hp_x, in[c], hop, hp_coef);
+  for (i=0;i<hop;i++) {
+    opus_val64 sum = 0;
+    for (c=0;c<count;c++) sum += channels[c]->hop_in[i];
+#ifdef FIXED_POINT
+    mix_in[i] = (celt_sig)(sum/count);
+#else
+    mix_in[i] = sum*(1.f/count);
+#endif
+  }
+  hop_gains(mix, g);
+  for (c=0;c<count;c++) {
+    DenoiseState *st = channels[c];
+    int buf_size = st->mode->pitch_buf_size;
+    kiss_fft_cpx X[FREQ_SIZE];
+    opus_val64 Ex[NB_BANDS];
+    hop_analysis(st, mode, X, Ex, st->hop_in);
+    RNN_MOVE(st->pitch_buf, &st->pitch_buf[hop], buf_size-hop);
+    RNN_COPY(&st->pitch_buf[buf_size-hop], st->hop_in, hop);
+    if (mix->hop_silence)
+      frame_synthesis(st, mode, out[c], X, NULL, out_scale);
+    else
+      hop_synthesis(st, mode, out[c], X, Ex, st->pitch_buf, buf_size, mix->last_period, g, out_scale);
+  }
+  return mix->hop_vad;
+}
+
+static opus_val16 process_frame(DenoiseState *st, float *out, const float *in,
+                                hp_coef_t hp_coef, float out_scale) {
   int i;
   kiss_fft_cpx X[FREQ_SIZE];
   kiss_fft_cpx P[WINDOW_SIZE];
-  float x[FRAME_SIZE];
-  float Ex[NB_BANDS], Ep[NB_BANDS];
-  float Exp[NB_BANDS];
-  float features[NB_FEATURES];
-  float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
-  float vad_prob = 0;
+  celt_sig x[FRAME_SIZE];
+  opus_val64 Ex[NB_BANDS], Ep[NB_BANDS];
+  opus_val16 Exp[NB_BANDS];
+  opus_val16 features[NB_FEATURES];
+  opus_val16 g[NB_BANDS];
+  opus_val32 gf[FREQ_SIZE];
+  opus_val16 vad_prob = st->vad_enabled ? 0 : Q15ONE;
   int silence;
-  static const float a_hp[2] = {-1.99599, 0.99600};
-  static const float b_hp[2] = {-2, 1};
-  biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
+  if (st->hop_mode != st->mode)
+    return process_hop(st, out, in, hp_coef, out_scale);
+  biquad_hp(x, st->mem_hp_x, in, st->mode->frame_size, hp_coef);
   silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
 
   if (!silence) {
-    compute_rnn(&st->rnn, g, &vad_prob, features);
-    pitch_filter(X, P, Ex, Ep, Exp, g);
+    opus_val32 r[NB_BANDS];
+    opus_val64 newE[NB_BANDS];
+    opus_val32 norm[NB_BANDS];
+    compute_rnn(&st->rnn, g, st->vad_enabled ? &vad_prob : NULL, features);
+    compute_pitch_gain(r, Ex, Ep, Exp, g);
+    apply_pitch_gain(X, newE, P, r, st->mode);
+    compute_energy_norm(norm, Ex, newE);
     for (i=0;i<NB_BANDS;i++) {
-      float alpha = .6f;
-      g[i] = MAX16(g[i], alpha*st->lastg[i]);
+      opus_val16 alpha = QCONST16(.6f, 15);
+      g[i] = MAX16(g[i], MULT16_16_Q15(alpha, st->lastg[i]));
       st->lastg[i] = g[i];
     }
-    interp_band_gain(gf, g);
-#if 1
-    for (i=0;i<FREQ_SIZE;i++) {
-      X[i].r *= gf[i];
-      X[i].i *= gf[i];
-    }
-#endif
+    interp_synthesis_gain(st->mode, gf, norm, g);
+    frame_synthesis(st, st->mode, out, X, gf, out_scale);
+  } else {
+    frame_synthesis(st, st->mode, out, X, NULL, out_scale);
   }
-
-  frame_synthesis(st, out, X);
   return vad_prob;
 }
 
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+  check_init();
+  return VAD2FLOAT(process_frame(st, out, in, st->mode->hp_block, 1.f));
+}
+
+float rnnoise_process_frame_float(DenoiseState *st, float *out, const float *in) {
+  check_init();
+  return VAD2FLOAT(process_frame(st, out, in, st->mode->hp_block_float, 1.f/FLOAT_SAMPLE_SCALE));
+}
+
+float rnnoise_process_frame_linked(DenoiseState *mix, DenoiseState *const *channels, int count,
+                                   float *const *out, const float *const *in) {
+  check_init();
+  return VAD2FLOAT(process_linked(mix, channels, count, out, in, mix->mode->hp_block, 1.f));
+}
+
+float rnnoise_process_frame_linked_float(DenoiseState *mix, DenoiseState *const *channels, int count,
+                                         float *const *out, const float *const *in) {
+  check_init();
+  return VAD2FLOAT(process_linked(mix, channels, count, out, in, mix->mode->hp_block_float,
+                                  1.f/FLOAT_SAMPLE_SCALE));
+}
+
 #if TRAINING
 
 static float uni_rand() {
@@ -519,8 +1515,6 @@ static void rand_resp(float *a, float *b) {
 int main(int argc, char **argv) {
   int i;
   int count=0;
-  static const float a_hp[2] = {-1.99599, 0.99600};
-  static const float b_hp[2] = {-2, 1};
   float a_noise[2] = {0};
   float b_noise[2] = {0};
   float a_sig[2] = {0};
@@ -36,6 +36,7 @@
 #endif
 
 #include "_kiss_fft_guts.h"
+#include "mathops.h"
 #define CUSTOM_MODES
 
 /* The guts header contains all the multiplication and addition macros that are defined for
@@ -67,8 +68,12 @@ static void kf_bfly2(
    } else
 #endif
    {
-      opus_val16 tw;
-      tw = QCONST16(0.7071067812f, 15);
+      kiss_twiddle_scalar tw;
+#ifdef FIXED_POINT
+      tw = 1518500250; /* 0.7071067812 in Q31 */
+#else
+      tw = 0.7071067812f;
+#endif
       /* We know that m==4 here because the radix-2 is just after a radix-4 */
       celt_assert(m==4);
       for (i=0;i<N;i++)
@@ -189,7 +194,7 @@ static void kf_bfly3(
    kiss_fft_cpx * Fout_beg = Fout;
 #ifdef FIXED_POINT
    /*epi3.r = -16384;*/ /* Unused */
-   epi3.i = -28378;
+   epi3.i = -1859775393;
 #else
    epi3 = st->twiddles[fstride*m];
 #endif
@@ -246,10 +251,10 @@ static void kf_bfly5(
    kiss_fft_cpx * Fout_beg = Fout;
 
 #ifdef FIXED_POINT
-   ya.r = 10126;
-   ya.i = -31164;
-   yb.r = -26510;
-   yb.i = -19261;
+   ya.r = 663608942;
+   ya.i = -2042378316;
+   yb.r = -1737350766;
+   yb.i = -1262259217;
 #else
    ya = st->twiddles[fstride*m];
    yb = st->twiddles[fstride*2*m];
@@ -406,18 +411,11 @@ int kf_factor(int n,opus_int16 * facbuf)
 static void compute_twiddles(kiss_twiddle_cpx *twiddles, int nfft)
 {
    int i;
-#ifdef FIXED_POINT
-   for (i=0;i<nfft;++i) {
-      opus_val32 phase = -i;
-      kf_cexp2(twiddles+i, DIV32(SHL32(phase,17),nfft));
-   }
-#else
    for (i=0;i<nfft;++i) {
       const double pi=3.14159265358979323846264338327;
       double phase = ( -2*pi /nfft ) * i;
       kf_cexp(twiddles+i, phase );
    }
-#endif
 }
 
 int opus_fft_alloc_arch_c(kiss_fft_state *st) {
@@ -39,7 +39,7 @@
 #include "common.h"
     //#include "modes.h"
     //#include "stack_alloc.h"
-    //#include "mathops.h"
+#include "mathops.h"
 #include "celt_lpc.h"
 #include "math.h"
 
@@ -108,9 +108,14 @@ static void find_best_pitch(opus_val32* xcorr, opus_val16* y, int len,
     }
 }
 
+/* In fixed point the output is left unrounded, in Q(SIG_SHIFT) of the input */
 static void celt_fir5(const opus_val16* x,
     const opus_val16* num,
+#ifdef FIXED_POINT
+    opus_val32* y,
+#else
     opus_val16* y,
+#endif
     int N,
     opus_val16* mem)
 {
@@ -140,7 +145,11 @@ static void celt_fir5(const opus_val16* x,
         mem2 = mem1;
         mem1 = mem0;
         mem0 = x[i];
+#ifdef FIXED_POINT
+        y[i] = sum;
+#else
         y[i] = ROUND16(sum, SIG_SHIFT);
+#endif
     }
     mem[0] = mem0;
     mem[1] = mem1;
@@ -169,7 +178,9 @@ void pitch_downsample(celt_sig* x[], opus_val16* x_lp,
     }
     if (maxabs < 1)
         maxabs = 1;
-    shift = celt_ilog2(maxabs) - 10;
+    /* Two more bits than the pitch search needs, the whitening below can
+       leave a residual much smaller than the input */
+    shift = celt_ilog2(maxabs) - 12;
     if (shift < 0)
         shift = 0;
     if (C == 2)
@@ -217,10 +228,34 @@ void pitch_downsample(celt_sig* x[], opus_val16* x_lp,
     lpc2[2] = lpc[2] + MULT16_16_Q15(c1, lpc[1]);
     lpc2[3] = lpc[3] + MULT16_16_Q15(c1, lpc[2]);
     lpc2[4] = MULT16_16_Q15(c1, lpc[3]);
+#ifdef FIXED_POINT
+    {
+#ifdef USE_MALLOC
+        opus_val32* res = malloc(sizeof(*res) * (len >> 1));
+#else
+        opus_val32 res[len >> 1];
+#endif
+        celt_fir5(x_lp, lpc2, res, len >> 1, mem);
+        /* Bring the residual to at most 11 bits, what the pitch search and
+           remove_doubling() assume */
+        shift = celt_ilog2(MAX32(1, celt_maxabs32(res, len >> 1))) - 10;
+        for (i = 0;i < len >> 1;i++)
+            x_lp[i] = EXTRACT16(shift > 0 ? PSHR32(res[i], shift) : SHL32(res[i], -shift));
+#ifdef USE_MALLOC
+        free(res);
+#endif
+    }
+#else
     celt_fir5(x_lp, lpc2, x_lp, len >> 1, mem);
+#endif
 }
 
-void celt_pitch_xcorr(const opus_val16* _x, const opus_val16* _y,
+#ifdef FIXED_POINT
+opus_val32
+#else
+void
+#endif
+celt_pitch_xcorr(const opus_val16* _x, const opus_val16* _y,
     opus_val32* xcorr, int len, int max_pitch)
 {
 
@@ -468,7 +503,7 @@ opus_val16 remove_doubling(opus_val16* x, int maxperiod, int minperiod,
 
     T = T0 = *T0_;
 #ifdef USE_MALLOC
-    opus_val16* yy_lookup = malloc(sizeof(*yy_lookup) * (maxperiod + 1));
+    opus_val32* yy_lookup = malloc(sizeof(*yy_lookup) * (maxperiod + 1));
 #else
     opus_val32 yy_lookup[maxperiod + 1];
 #endif
@@ -535,7 +570,11 @@ opus_val16 remove_doubling(opus_val16* x, int maxperiod, int minperiod,
     if (best_yy <= best_xy)
         pg = Q15ONE;
     else
+#ifdef FIXED_POINT
+        pg = SHR32(frac_div32(best_xy, best_yy + 1), 16);
+#else
         pg = best_xy / (best_yy + 1);
+#endif
 
     for (k = 0;k < 3;k++)
         xcorr[k] = celt_inner_prod(x, x - (T + k - 1), N);
@@ -34,10 +34,14 @@
 #include "common.h"
 #include "arch.h"
 #include "tansig_table.h"
+#include "tansig_approx.h"
 #include "rnn.h"
 #include "rnn_data.h"
+#include "vec_avx.h"
 #include <stdio.h>
 
+#define INPUT_SIZE 42
+
 // SIMD
 #include <immintrin.h>
 #if !defined(_WIN32)
@@ -128,45 +132,184 @@ int is_avx2_supported() {
 #endif
 }
 
+#if defined(RNN_AVX512)
+static void cpuid_count(int leaf, int subleaf, int *cpuInfo) {
+#if defined(__GNUC__)
+    __cpuid_count(leaf, subleaf, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
+#else // _WIN32
+    __cpuidex(cpuInfo, leaf, subleaf);
+#endif
+}
+#endif
+
+int is_avx512_supported() {
+#if defined(RNN_AVX512)
+    int cpuInfo[4];
 
-static OPUS_INLINE float tansig_approx(float x)
-{
-    int i;
-    float y, dy;
-    float sign=1;
-    /* Tests are reversed to catch NaNs */
-    if (!(x<8))
-        return 1;
-    if (!(x>-8))
-        return -1;
-#ifndef FIXED_POINT
-    /* Another check in case of -ffast-math */
-    if (celt_isnan(x))
-       return 0;
-#endif
-    if (x<0)
-    {
-       x=-x;
-       sign=-1;
+#if !defined(__GNUC__) && !defined(_WIN32)
+    return 0;
+#endif
+#if defined(_WIN32) && !defined(HAS_CPUID)
+    return 0;
+#endif
+
+    cpuid_count(0, 0, cpuInfo);
+    if (cpuInfo[0] < 7) {
+        return 0;
+    }
+
+    cpuid_count(1, 0, cpuInfo);
+    if (!(cpuInfo[2] & 0x08000000)) { // OSXSAVE
+        return 0;
     }
-    i = (int)floor(.5f+25*x);
-    x -= .04f*i;
-    y = tansig_table[i];
-    dy = 1-y*y;
-    y = y + x*dy*(1 - y*x);
-    return sign*y;
+
+    // The OS must save the opmask and both halves of the ZMM registers
+    if ((_xgetbv(0) & 0xE6) != 0xE6) {
+        return 0;
+    }
+
+    cpuid_count(7, 0, cpuInfo);
+    // AVX512F, AVX512BW, AVX512VL
+    return (cpuInfo[1] & 0x00010000) && (cpuInfo[1] & 0x40000000) && (cpuInfo[1] & 0x80000000);
+#else
+    return 0;
+#endif
 }
 
-static OPUS_INLINE float sigmoid_approx(float x)
-{
-   return .5 + .5*tansig_approx(.5*x);
+int is_avx512_vnni_supported() {
+#if defined(RNN_AVX512_VNNI)
+    int cpuInfo[4];
+
+    if (!is_avx512_supported()) {
+        return 0;
+    }
+    cpuid_count(7, 0, cpuInfo);
+    return (cpuInfo[2] & 0x00000800) != 0; // AVX512_VNNI
+#else
+    return 0;
+#endif
 }
 
+
 static OPUS_INLINE float relu(float x)
 {
    return x < 0 ? 0 : x;
 }
 
+static void compute_activation(float *output, int N, int activation)
+{
+   int i;
+   if (activation == ACTIVATION_SIGMOID) {
+      for (i=0;i<N;i++)
+         output[i] = sigmoid_approx(output[i]);
+   } else if (activation == ACTIVATION_TANH) {
+      for (i=0;i<N;i++)
+         output[i] = tansig_approx(output[i]);
+   } else if (activation == ACTIVATION_RELU) {
+      for (i=0;i<N;i++)
+         output[i] = relu(output[i]);
+   } else {
+     *(int*)0=0;
+   }
+}
+
+#if defined(_MSC_VER)
+#define RNN_ALWAYS_INLINE __forceinline
+#else
+#define RNN_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+/* Scales the sums of a layer and applies its activation. Called with a constant
+   activation from the specialized kernels so the branch folds away. */
+static RNN_ALWAYS_INLINE void scale_and_activate(float *h, int N, int activation)
+{
+   int i;
+   if (activation == ACTIVATION_SIGMOID) {
+      for (i=0;i<N;i++)
+         h[i] = sigmoid_approx(WEIGHTS_SCALE*h[i]);
+   } else if (activation == ACTIVATION_TANH) {
+      for (i=0;i<N;i++)
+         h[i] = tansig_approx(WEIGHTS_SCALE*h[i]);
+   } else {
+      for (i=0;i<N;i++)
+         h[i] = relu(WEIGHTS_SCALE*h[i]);
+   }
+}
+
+/* Feature stack of the built-in models: input_dense, noise_gru and denoise_gru */
+#define BUILTIN_FEATURE_COLS (24 + 3 * 48 + 3 * 96)
+
+#define GRU_ARGS const GRULayer* gru, float* state, const float* input, int nb_inputs, const float* input_sum
+
+/* Instantiates a GRU kernel for one number of neurons (or gru->nb_neurons) and
+   each activation. */
+#define DEFINE_GRU_SHAPE(name, impl, tag, n) \
+static void name##_##tag##_sigmoid(GRU_ARGS) { impl(gru, state, input, nb_inputs, input_sum, n, ACTIVATION_SIGMOID); } \
+static void name##_##tag##_tanh(GRU_ARGS) { impl(gru, state, input, nb_inputs, input_sum, n, ACTIVATION_TANH); } \
+static void name##_##tag##_relu(GRU_ARGS) { impl(gru, state, input, nb_inputs, input_sum, n, ACTIVATION_RELU); } \
+static void name##_##tag(GRU_ARGS) \
+{ \
+    if (gru->activation == ACTIVATION_SIGMOID) name##_##tag##_sigmoid(gru, state, input, nb_inputs, input_sum); \
+    else if (gru->activation == ACTIVATION_TANH) name##_##tag##_tanh(gru, state, input, nb_inputs, input_sum); \
+    else if (gru->activation == ACTIVATION_RELU) name##_##tag##_relu(gru, state, input, nb_inputs, input_sum); \
+    else *(int*)0 = 0; \
+}
+
+/* Fully unrolled kernels for the GRU sizes of the built-in models, with the
+   generic kernel as the fallback for models loaded from file. */
+#define DEFINE_GRU_KERNEL(name, impl) \
+DEFINE_GRU_SHAPE(name, impl, any, gru->nb_neurons) \
+DEFINE_GRU_SHAPE(name, impl, 24, 24) \
+DEFINE_GRU_SHAPE(name, impl, 48, 48) \
+DEFINE_GRU_SHAPE(name, impl, 96, 96) \
+void name(GRU_ARGS) \
+{ \
+    switch (gru->nb_neurons) { \
+    case 24: name##_24(gru, state, input, nb_inputs, input_sum); break; \
+    case 48: name##_48(gru, state, input, nb_inputs, input_sum); break; \
+    case 96: name##_96(gru, state, input, nb_inputs, input_sum); break; \
+    default: name##_any(gru, state, input, nb_inputs, input_sum); break; \
+    } \
+}
+
+/* Same for dense layers, specialized on the built-in 42->24 tanh, 96->22 and
+   24->1 sigmoid shapes. */
+#define DEFINE_DENSE_KERNEL(name, impl) \
+void name(const DenseLayer *layer, float *output, const float *input) \
+{ \
+    int M = layer->nb_inputs; \
+    int N = layer->nb_neurons; \
+    if (M == 42 && N == 24 && layer->activation == ACTIVATION_TANH) impl(layer, output, input, 42, 24, ACTIVATION_TANH); \
+    else if (M == 96 && N == 22 && layer->activation == ACTIVATION_SIGMOID) impl(layer, output, input, 96, 22, ACTIVATION_SIGMOID); \
+    else if (M == 24 && N == 1 && layer->activation == ACTIVATION_SIGMOID) impl(layer, output, input, 24, 1, ACTIVATION_SIGMOID); \
+    else if (layer->activation == ACTIVATION_SIGMOID) impl(layer, output, input, M, N, ACTIVATION_SIGMOID); \
+    else if (layer->activation == ACTIVATION_TANH) impl(layer, output, input, M, N, ACTIVATION_TANH); \
+    else if (layer->activation == ACTIVATION_RELU) impl(layer, output, input, M, N, ACTIVATION_RELU); \
+    else *(int*)0 = 0; \
+}
+
+/* Starts the gate sums from the bias, or from sums that already include the
+   projection of some of the inputs. */
+static OPUS_INLINE void init_gate_sums(float *sum, const rnn_weight *bias, const float *input_sum, int N)
+{
+    int i;
+    if (input_sum) {
+        memcpy(sum, input_sum, 3 * N * sizeof(float));
+    } else {
+        for (i = 0; i < 3 * N; i++)
+            sum[i] = bias[i];
+    }
+}
+
+/* out[i] += sum_j w[j*stride + i]*x[j] for i < cols */
+static void accumulate_matvec(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M)
+{
+    int i, j;
+    for (j = 0; j < M; j++)
+        for (i = 0; i < cols; i++)
+            out[i] += w[j * stride + i] * x[j];
+}
+
 void compute_dense(const DenseLayer *layer, float *output, const float *input)
 {
    int i, j;
@@ -183,189 +326,183 @@ void compute_dense(const DenseLayer *layer, float *output, const float *input)
          sum += layer->input_weights[j*stride + i]*input[j];
       output[i] = WEIGHTS_SCALE*sum;
    }
-   if (layer->activation == ACTIVATION_SIGMOID) {
-      for (i=0;i<N;i++)
-         output[i] = sigmoid_approx(output[i]);
-   } else if (layer->activation == ACTIVATION_TANH) {
-      for (i=0;i<N;i++)
-         output[i] = tansig_approx(output[i]);
-   } else if (layer->activation == ACTIVATION_RELU) {
-      for (i=0;i<N;i++)
-         output[i] = relu(output[i]);
-   } else {
-     *(int*)0=0;
-   }
+   compute_activation(output, N, layer->activation);
 }
 
 #if defined(__AVX2__)
-#include <immintrin.h>
+static OPUS_INLINE __m256 load_weights8(const rnn_weight *w)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)w)));
+}
 
-// Use native FMA if available, otherwise fall back to multiply + add
-#ifdef __FMA__
-#define _MM256_FMADD_PS(a, b, c) _mm256_fmadd_ps(a, b, c)
-#else
-static OPUS_INLINE __m256 _mm256_fmadd_ps_fallback(__m256 a, __m256 b, __m256 c) {
-    __m256 multiplied = _mm256_mul_ps(a, b);
-    return _mm256_add_ps(c, multiplied);
+/* scale_and_activate() eight outputs at a time */
+static RNN_ALWAYS_INLINE void scale_and_activate_avx2(float *h, int N, int activation)
+{
+    int i;
+    const __m256 scale = _mm256_set1_ps(WEIGHTS_SCALE);
+    for (i = 0; i + 8 <= N; i += 8) {
+        __m256 x = _mm256_mul_ps(scale, _mm256_loadu_ps(&h[i]));
+        if (activation == ACTIVATION_SIGMOID)
+            x = sigmoid_approx8(x);
+        else if (activation == ACTIVATION_TANH)
+            x = tansig_approx8(x);
+        else
+            x = _mm256_max_ps(x, _mm256_setzero_ps());
+        _mm256_storeu_ps(&h[i], x);
+    }
+    scale_and_activate(&h[i], N - i, activation);
 }
 
-#define _MM256_FMADD_PS(a, b, c) _mm256_fmadd_ps_fallback(a, b, c)
-#endif
+/* Update gate z and reset state*r from the first 2*N gate sums. z may alias sum. */
+static RNN_ALWAYS_INLINE void gru_gates_avx2(float *z, float *rs, const float *sum, const float *state, int N)
+{
+    int i;
+    const __m256 scale = _mm256_set1_ps(WEIGHTS_SCALE);
+    for (i = 0; i + 8 <= N; i += 8) {
+        __m256 r = sigmoid_approx8(_mm256_mul_ps(scale, _mm256_loadu_ps(&sum[N + i])));
+        _mm256_storeu_ps(&z[i], sigmoid_approx8(_mm256_mul_ps(scale, _mm256_loadu_ps(&sum[i]))));
+        _mm256_storeu_ps(&rs[i], _mm256_mul_ps(_mm256_loadu_ps(&state[i]), r));
+    }
+    for (; i < N; i++) {
+        z[i] = sigmoid_approx(WEIGHTS_SCALE * sum[i]);
+        rs[i] = state[i] * sigmoid_approx(WEIGHTS_SCALE * sum[N + i]);
+    }
+}
 
-void compute_gru_avx2(const GRULayer* gru, float* state, const float* input)
+/* out[i] += sum_j w[j*stride + i]*x[j] for i < cols. Each x[j] is broadcast
+   once per block of 32 outputs. */
+static RNN_ALWAYS_INLINE void matvec_avx2(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M)
 {
     int i, j;
-    int N, M;
-    int stride;
-    float z[MAX_NEURONS];
-    float r[MAX_NEURONS];
-    float h[MAX_NEURONS];
-    M = gru->nb_inputs;
-    N = gru->nb_neurons;
-    stride = 3 * N;
-
-    int chunk_size = 8;
-    int n_remainder = N % chunk_size;
-    int n_chunk_count = (N - n_remainder) / chunk_size;
-
-    for (int i_chunk = 0; i_chunk < n_chunk_count; i_chunk++) {
-        // Load i8s
-        __m128i i8_z_sum = _mm_loadu_si128((__m128i*) & gru->bias[i_chunk * chunk_size]);
-        __m128i i8_r_sum = _mm_loadu_si128((__m128i*) & gru->bias[N + (i_chunk * chunk_size)]);
-        // Sign-extend to i32s
-        __m256i i32_z_sum = _mm256_cvtepi8_epi32(i8_z_sum);
-        __m256i i32_r_sum = _mm256_cvtepi8_epi32(i8_r_sum);
-        // Convert to f32s
-        __m256 z_sum = _mm256_cvtepi32_ps(i32_z_sum);
-        __m256 r_sum = _mm256_cvtepi32_ps(i32_r_sum);
-
+    for (i = 0; i + 32 <= cols; i += 32) {
+        __m256 sum0 = _mm256_loadu_ps(&out[i]);
+        __m256 sum1 = _mm256_loadu_ps(&out[i + 8]);
+        __m256 sum2 = _mm256_loadu_ps(&out[i + 16]);
+        __m256 sum3 = _mm256_loadu_ps(&out[i + 24]);
         for (j = 0; j < M; j++) {
-            // Load i8s
-            __m128i z_input_weights_i8 = _mm_loadu_si128((__m128i*) & gru->input_weights[j * stride + (i_chunk * chunk_size)]);
-            __m128i r_input_weights_i8 = _mm_loadu_si128((__m128i*) & gru->input_weights[N + j * stride + (i_chunk * chunk_size)]);
-            // Sign-extend to i32s
-            __m256i z_input_weights_i32 = _mm256_cvtepi8_epi32(z_input_weights_i8);
-            __m256i r_input_weights_i32 = _mm256_cvtepi8_epi32(r_input_weights_i8);
-            // Convert to f32s
-            __m256 z_input_weights = _mm256_cvtepi32_ps(z_input_weights_i32);
-            __m256 r_input_weights = _mm256_cvtepi32_ps(r_input_weights_i32);
-
-            __m256 input_v = _mm256_broadcast_ss(&input[j]);
-
-            z_sum = _MM256_FMADD_PS(z_input_weights, input_v, z_sum);
-            r_sum = _MM256_FMADD_PS(r_input_weights, input_v, r_sum);
-        }
-        for (j = 0; j < N; j++) {
-            // Load i8s
-            __m128i z_recurrent_weights_i8 = _mm_loadu_si128((__m128i*) & gru->recurrent_weights[j * stride + (i_chunk * chunk_size)]);
-            __m128i r_recurrent_weights_i8 = _mm_loadu_si128((__m128i*) & gru->recurrent_weights[N + j * stride + (i_chunk * chunk_size)]);
-            // Sign-extend to i32s
-            __m256i z_recurrent_weights_i32 = _mm256_cvtepi8_epi32(z_recurrent_weights_i8);
-            __m256i r_recurrent_weights_i32 = _mm256_cvtepi8_epi32(r_recurrent_weights_i8);
-            // Convert to f32s
-            __m256 z_recurrent_weights = _mm256_cvtepi32_ps(z_recurrent_weights_i32);
-            __m256 r_recurrent_weights = _mm256_cvtepi32_ps(r_recurrent_weights_i32);
-
-            __m256 state_v = _mm256_broadcast_ss(&state[j]);
-
-            z_sum = _MM256_FMADD_PS(z_recurrent_weights, state_v, z_sum);
-            r_sum = _MM256_FMADD_PS(r_recurrent_weights, state_v, r_sum);
+            const rnn_weight *w_j = &w[j * stride + i];
+            __m256 x_v = _mm256_broadcast_ss(&x[j]);
+            sum0 = _MM256_FMADD_PS(load_weights8(w_j), x_v, sum0);
+            sum1 = _MM256_FMADD_PS(load_weights8(w_j + 8), x_v, sum1);
+            sum2 = _MM256_FMADD_PS(load_weights8(w_j + 16), x_v, sum2);
+            sum3 = _MM256_FMADD_PS(load_weights8(w_j + 24), x_v, sum3);
         }
-
-        // Store sums
-        _mm256_storeu_ps(&z[i_chunk * chunk_size], z_sum);
-        _mm256_storeu_ps(&r[i_chunk * chunk_size], r_sum);
+        _mm256_storeu_ps(&out[i], sum0);
+        _mm256_storeu_ps(&out[i + 8], sum1);
+        _mm256_storeu_ps(&out[i + 16], sum2);
+        _mm256_storeu_ps(&out[i + 24], sum3);
     }
-    // Remainders
-    for (int i = n_chunk_count * chunk_size; i < N; i++) {
-        float z_sum = gru->bias[i];
-        float r_sum = gru->bias[N + i];
-
-        for (j = 0; j < M;j++) {
-            /* Compute update gate. */
-            z_sum += gru->input_weights[j * stride + i] * input[j];
-            /* Compute reset gate. */
-            r_sum += gru->input_weights[N + j * stride + i] * input[j];
-        }
-        for (j = 0; j < N;j++) {
-            /* Compute update gate. */
-            z_sum += gru->recurrent_weights[j * stride + i] * state[j];
-            /* Compute reset gate. */
-            r_sum += gru->recurrent_weights[N + j * stride + i] * state[j];
-        }
-
-        z[i] = z_sum;
-        r[i] = r_sum;
+    for (; i + 8 <= cols; i += 8) {
+        __m256 sum = _mm256_loadu_ps(&out[i]);
+        for (j = 0; j < M; j++)
+            sum = _MM256_FMADD_PS(load_weights8(&w[j * stride + i]), _mm256_broadcast_ss(&x[j]), sum);
+        _mm256_storeu_ps(&out[i], sum);
     }
-    // Apply sigmoid to sums
-    for (i = 0; i < N; i++) {
-        z[i] = sigmoid_approx(WEIGHTS_SCALE * z[i]);
-        r[i] = sigmoid_approx(WEIGHTS_SCALE * r[i]);
+    for (; i < cols; i++) {
+        float sum = out[i];
+        for (j = 0; j < M; j++)
+            sum += w[j * stride + i] * x[j];
+        out[i] = sum;
     }
+}
 
-    /* Compute output. */
-    for (int i_chunk = 0; i_chunk < n_chunk_count; i_chunk++) {
-        // Load i8s
-        __m128i i8_sum = _mm_loadu_si128((__m128i*) & gru->bias[2 * N + (i_chunk * chunk_size)]);
-        // Sign-extend to i32s
-        __m256i i32_sum = _mm256_cvtepi8_epi32(i8_sum);
-        // Convert to f32s
-        __m256 sum = _mm256_cvtepi32_ps(i32_sum);
-
-        for (j = 0; j < M; j++) {
-            // Load i8s
-            __m128i input_weights_i8 = _mm_loadu_si128((__m128i*) & gru->input_weights[2 * N + j * stride + (i_chunk * chunk_size)]);
-            // Sign-extend to i32s
-            __m256i input_weights_i32 = _mm256_cvtepi8_epi32(input_weights_i8);
-            // Convert to f32s
-            __m256 input_weights = _mm256_cvtepi32_ps(input_weights_i32);
-
-            __m256 input_v = _mm256_broadcast_ss(&input[j]);
-
-            sum = _MM256_FMADD_PS(input_weights, input_v, sum);
-        }
+static void accumulate_matvec_avx2(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M)
+{
+    if (stride == BUILTIN_FEATURE_COLS && cols == BUILTIN_FEATURE_COLS && M == INPUT_SIZE)
+        matvec_avx2(out, w, BUILTIN_FEATURE_COLS, BUILTIN_FEATURE_COLS, x, INPUT_SIZE);
+    else
+        matvec_avx2(out, w, stride, cols, x, M);
+}
 
-        for (j = 0; j < N; j++) {
-            // Load i8s
-            __m128i recurrent_weights_i8 = _mm_loadu_si128((__m128i*) & gru->recurrent_weights[2 * N + j * stride + (i_chunk * chunk_size)]);
-            // Sign-extend to i32s
-            __m256i recurrent_weights_i32 = _mm256_cvtepi8_epi32(recurrent_weights_i8);
-            // Convert to f32s
-            __m256 recurrent_weights = _mm256_cvtepi32_ps(recurrent_weights_i32);
+static RNN_ALWAYS_INLINE void dense_avx2(const DenseLayer *layer, float *output, const float *input,
+                                         int M, int N, int activation)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        output[i] = layer->bias[i];
+    matvec_avx2(output, layer->input_weights, N, N, input, M);
+    scale_and_activate_avx2(output, N, activation);
+}
 
-            float state_times_r = state[j] * r[j];
-            __m256 state_times_r_v = _mm256_set1_ps(state_times_r);
+DEFINE_DENSE_KERNEL(compute_dense_avx2, dense_avx2)
 
-            sum = _MM256_FMADD_PS(recurrent_weights, state_times_r_v, sum);
+/* Same as matvec_avx2() over the stored blocks of a block-sparse matrix, for
+   outputs col0 to col0 + cols. Blocks starting at or past input M are skipped;
+   x must be readable (and finite) up to the end of the last block. */
+static void sparse_matvec_avx2(float *out, const rnn_weight *w, const int *block_offset, const int *block_rows,
+                               int col0, int cols, const float *x, int M)
+{
+    int i, b;
+    for (i = 0; i < cols; i += SPARSE_BLOCK_OUTPUTS) {
+        int group = (col0 + i) / SPARSE_BLOCK_OUTPUTS;
+        __m256 sum = _mm256_loadu_ps(&out[i]);
+        for (b = block_offset[group]; b < block_offset[group + 1]; b++) {
+            const rnn_weight *w_b = &w[b * SPARSE_BLOCK_INPUTS * SPARSE_BLOCK_OUTPUTS];
+            const float *x_b = &x[block_rows[b]];
+            if (block_rows[b] >= M)
+                continue;
+            sum = _MM256_FMADD_PS(load_weights8(w_b), _mm256_broadcast_ss(&x_b[0]), sum);
+            sum = _MM256_FMADD_PS(load_weights8(w_b + 8), _mm256_broadcast_ss(&x_b[1]), sum);
+            sum = _MM256_FMADD_PS(load_weights8(w_b + 16), _mm256_broadcast_ss(&x_b[2]), sum);
+            sum = _MM256_FMADD_PS(load_weights8(w_b + 24), _mm256_broadcast_ss(&x_b[3]), sum);
         }
-
-        // Store sums
-        _mm256_storeu_ps(&h[i_chunk * chunk_size], sum);
+        _mm256_storeu_ps(&out[i], sum);
     }
-    // Remainders
-    for (int i = n_chunk_count * chunk_size; i < N; i++) {
-        float sum = gru->bias[2 * N + i];
-        for (j = 0; j < M; j++)
-            sum += gru->input_weights[2 * N + j * stride + i] * input[j];
-        for (j = 0; j < N; j++)
-            sum += gru->recurrent_weights[2 * N + j * stride + i] * state[j] * r[j];
+}
 
-        h[i] = sum;
-    }
+static RNN_ALWAYS_INLINE void gru_avx2(const GRULayer* gru, float* state, const float* input,
+                                       int nb_inputs, const float* input_sum, int N, int activation)
+{
+    int i;
+    int M;
+    int stride;
+    float sum[3 * MAX_NEURONS];
+    float rs[MAX_NEURONS];
+    float *z, *h;
+    M = nb_inputs;
+    stride = 3 * N;
+    z = sum;
+    h = &sum[2 * N];
 
-    for (i = 0; i < N; i++) {
-        float sum = h[i];
+    init_gate_sums(sum, gru->bias, input_sum, N);
+    /* Input projections of all three gates in a single sweep over each row. */
+    if (gru->input_weights_sparse) {
+        float padded_input[3 * MAX_NEURONS + SPARSE_BLOCK_INPUTS];
+        memcpy(padded_input, input, M * sizeof(float));
+        memset(&padded_input[M], 0, SPARSE_BLOCK_INPUTS * sizeof(float));
+        sparse_matvec_avx2(sum, gru->input_weights_sparse, gru->input_block_offset, gru->input_block_rows,
+                           0, stride, padded_input, M);
+    } else {
+        matvec_avx2(sum, gru->input_weights, stride, stride, input, M);
+    }
+    if (gru->recurrent_weights_sparse)
+        sparse_matvec_avx2(sum, gru->recurrent_weights_sparse, gru->recurrent_block_offset, gru->recurrent_block_rows,
+                           0, 2 * N, state, N);
+    else
+        matvec_avx2(sum, gru->recurrent_weights, stride, 2 * N, state, N);
+    gru_gates_avx2(z, rs, sum, state, N);
 
-        if (gru->activation == ACTIVATION_SIGMOID) sum = sigmoid_approx(WEIGHTS_SCALE * sum);
-        else if (gru->activation == ACTIVATION_TANH) sum = tansig_approx(WEIGHTS_SCALE * sum);
-        else if (gru->activation == ACTIVATION_RELU) sum = relu(WEIGHTS_SCALE * sum);
-        else *(int*)0 = 0;
-        state[i] = z[i] * state[i] + (1 - z[i]) * sum;
+    /* Compute output. */
+    if (gru->recurrent_weights_sparse)
+        sparse_matvec_avx2(h, gru->recurrent_weights_sparse, gru->recurrent_block_offset, gru->recurrent_block_rows,
+                           2 * N, N, rs, N);
+    else
+        matvec_avx2(h, &gru->recurrent_weights[2 * N], stride, N, rs, N);
+    scale_and_activate_avx2(h, N, activation);
+    /* state = z*state + (1 - z)*h */
+    for (i = 0; i + 8 <= N; i += 8) {
+        __m256 h_v = _mm256_loadu_ps(&h[i]);
+        __m256 state_v = _mm256_sub_ps(_mm256_loadu_ps(&state[i]), h_v);
+        _mm256_storeu_ps(&state[i], _MM256_FMADD_PS(_mm256_loadu_ps(&z[i]), state_v, h_v));
     }
+    for (; i < N; i++)
+        state[i] = h[i] + z[i] * (state[i] - h[i]);
 }
+
+DEFINE_GRU_KERNEL(compute_gru_avx2, gru_avx2)
 #endif
 
-void compute_gru(const GRULayer *gru, float *state, const float *input)
+void compute_gru(const GRULayer *gru, float *state, const float *input, int nb_inputs, const float *input_sum)
 {
     int i, j;
     int N, M;
@@ -373,13 +510,13 @@ void compute_gru(const GRULayer *gru, float *state, const float *input)
     float z[MAX_NEURONS];
     float r[MAX_NEURONS];
     float h[MAX_NEURONS];
-    M = gru->nb_inputs;
+    M = nb_inputs;
     N = gru->nb_neurons;
     stride = 3 * N;
     for (i = 0; i < N; i++)
     {
-        float z_sum = gru->bias[i];
-        float r_sum = gru->bias[N + i];
+        float z_sum = input_sum ? input_sum[i] : gru->bias[i];
+        float r_sum = input_sum ? input_sum[N + i] : gru->bias[N + i];
 
         for (j = 0; j < M;j++) {
             /* Compute update gate. */
@@ -400,7 +537,7 @@ void compute_gru(const GRULayer *gru, float *state, const float *input)
 
     /* Compute output. */
     for (i = 0; i < N; i++) {
-        float sum = gru->bias[2 * N + i];
+        float sum = input_sum ? input_sum[2 * N + i] : gru->bias[2 * N + i];
         for (j = 0; j < M; j++)
             sum += gru->input_weights[2 * N + j * stride + i] * input[j];
         for (j = 0; j < N; j++)
@@ -411,27 +548,721 @@ void compute_gru(const GRULayer *gru, float *state, const float *input)
         else *(int*)0 = 0;
         h[i] = z[i] * state[i] + (1 - z[i]) * sum;
     }
-    memcpy((void*)&state, (void*)&h, N * sizeof(float));
+    memcpy(state, h, N * sizeof(float));
 }
 
-#define INPUT_SIZE 42
+#if defined(RNN_AVX512)
+#define TAIL_MASK16(n) ((__mmask16)((n) >= 16 ? 0xFFFF : (1u << (n)) - 1))
+
+static OPUS_INLINE __m512 load_weights16(const rnn_weight *w, __mmask16 mask)
+{
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_maskz_loadu_epi8(mask, w)));
+}
+
+/* scale_and_activate() sixteen outputs at a time */
+static RNN_ALWAYS_INLINE void scale_and_activate_avx512(float *h, int N, int activation)
+{
+    int i;
+    const __m512 scale = _mm512_set1_ps(WEIGHTS_SCALE);
+    for (i = 0; i < N; i += 16) {
+        __mmask16 mask = TAIL_MASK16(N - i);
+        __m512 x = _mm512_mul_ps(scale, _mm512_maskz_loadu_ps(mask, &h[i]));
+        if (activation == ACTIVATION_SIGMOID)
+            x = sigmoid_approx16(x);
+        else if (activation == ACTIVATION_TANH)
+            x = tansig_approx16(x);
+        else
+            x = _mm512_max_ps(x, _mm512_setzero_ps());
+        _mm512_mask_storeu_ps(&h[i], mask, x);
+    }
+}
+
+static RNN_ALWAYS_INLINE void gru_gates_avx512(float *z, float *rs, const float *sum, const float *state, int N)
+{
+    int i;
+    const __m512 scale = _mm512_set1_ps(WEIGHTS_SCALE);
+    for (i = 0; i < N; i += 16) {
+        __mmask16 mask = TAIL_MASK16(N - i);
+        __m512 r = sigmoid_approx16(_mm512_mul_ps(scale, _mm512_maskz_loadu_ps(mask, &sum[N + i])));
+        _mm512_mask_storeu_ps(&z[i], mask, sigmoid_approx16(_mm512_mul_ps(scale, _mm512_maskz_loadu_ps(mask, &sum[i]))));
+        _mm512_mask_storeu_ps(&rs[i], mask, _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, &state[i]), r));
+    }
+}
+
+/* out[i] += sum_j w[j*stride + i]*x[j] for i < cols, 64 outputs at a time */
+static RNN_ALWAYS_INLINE void matvec_avx512(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M)
+{
+    int i, j;
+    for (i = 0; i + 64 <= cols; i += 64) {
+        __m512 sum0 = _mm512_loadu_ps(&out[i]);
+        __m512 sum1 = _mm512_loadu_ps(&out[i + 16]);
+        __m512 sum2 = _mm512_loadu_ps(&out[i + 32]);
+        __m512 sum3 = _mm512_loadu_ps(&out[i + 48]);
+        for (j = 0; j < M; j++) {
+            const rnn_weight *w_j = &w[j * stride + i];
+            __m512 x_v = _mm512_set1_ps(x[j]);
+            sum0 = _mm512_fmadd_ps(load_weights16(w_j, 0xFFFF), x_v, sum0);
+            sum1 = _mm512_fmadd_ps(load_weights16(w_j + 16, 0xFFFF), x_v, sum1);
+            sum2 = _mm512_fmadd_ps(load_weights16(w_j + 32, 0xFFFF), x_v, sum2);
+            sum3 = _mm512_fmadd_ps(load_weights16(w_j + 48, 0xFFFF), x_v, sum3);
+        }
+        _mm512_storeu_ps(&out[i], sum0);
+        _mm512_storeu_ps(&out[i + 16], sum1);
+        _mm512_storeu_ps(&out[i + 32], sum2);
+        _mm512_storeu_ps(&out[i + 48], sum3);
+    }
+    for (; i < cols; i += 16) {
+        __mmask16 mask = TAIL_MASK16(cols - i);
+        __m512 sum = _mm512_maskz_loadu_ps(mask, &out[i]);
+        for (j = 0; j < M; j++)
+            sum = _mm512_fmadd_ps(load_weights16(&w[j * stride + i], mask), _mm512_set1_ps(x[j]), sum);
+        _mm512_mask_storeu_ps(&out[i], mask, sum);
+    }
+}
 
+static void accumulate_matvec_avx512(float *out, const rnn_weight *w, int stride, int cols, const float *x, int M)
+{
+    if (stride == BUILTIN_FEATURE_COLS && cols == BUILTIN_FEATURE_COLS && M == INPUT_SIZE)
+        matvec_avx512(out, w, BUILTIN_FEATURE_COLS, BUILTIN_FEATURE_COLS, x, INPUT_SIZE);
+    else
+        matvec_avx512(out, w, stride, cols, x, M);
+}
+
+static RNN_ALWAYS_INLINE void dense_avx512(const DenseLayer *layer, float *output, const float *input,
+                                           int M, int N, int activation)
+{
+    int i;
+    for (i = 0; i < N; i++)
+        output[i] = layer->bias[i];
+    matvec_avx512(output, layer->input_weights, N, N, input, M);
+    scale_and_activate_avx512(output, N, activation);
+}
+
+DEFINE_DENSE_KERNEL(compute_dense_avx512, dense_avx512)
+
+/* state = z*state + (1 - z)*h */
+static OPUS_INLINE void gru_blend_avx512(float *state, const float *z, const float *h, int N)
+{
+    int i;
+    for (i = 0; i < N; i += 16) {
+        __mmask16 mask = TAIL_MASK16(N - i);
+        __m512 h_v = _mm512_maskz_loadu_ps(mask, &h[i]);
+        __m512 state_v = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, &state[i]), h_v);
+        _mm512_mask_storeu_ps(&state[i], mask, _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &z[i]), state_v, h_v));
+    }
+}
+
+static RNN_ALWAYS_INLINE void gru_avx512(const GRULayer* gru, float* state, const float* input,
+                                         int nb_inputs, const float* input_sum, int N, int activation)
+{
+    int M;
+    int stride;
+    float sum[3 * MAX_NEURONS];
+    float rs[MAX_NEURONS];
+    float *z, *h;
+    M = nb_inputs;
+    stride = 3 * N;
+    z = sum;
+    h = &sum[2 * N];
+
+    init_gate_sums(sum, gru->bias, input_sum, N);
+    /* Input projections of all three gates in a single sweep over each row. */
+    matvec_avx512(sum, gru->input_weights, stride, stride, input, M);
+    matvec_avx512(sum, gru->recurrent_weights, stride, 2 * N, state, N);
+    gru_gates_avx512(z, rs, sum, state, N);
+
+    /* Compute output. */
+    matvec_avx512(h, &gru->recurrent_weights[2 * N], stride, N, rs, N);
+    scale_and_activate_avx512(h, N, activation);
+    gru_blend_avx512(state, z, h, N);
+}
+
+DEFINE_GRU_KERNEL(compute_gru_avx512, gru_avx512)
+#endif
+
+#if defined(RNN_AVX512_VNNI)
+/* Activations are quantized with one scale per block of inputs, so that the
+   features, which have a much wider range than the GRU states, do not crush
+   the resolution of the rest of the input vector. */
+#define VNNI_BLOCK 16
+#define VNNI_MAX_BLOCKS ((3 * MAX_NEURONS + VNNI_BLOCK - 1) / VNNI_BLOCK)
+
+/* Quantizes x to unsigned 8 bits around 128, padding the last block with 128.
+   Stores the inverse of the scale applied to each block. */
+static RNN_ALWAYS_INLINE void quantize_u8(unsigned char *q, float *inv_scale, const float *x, int N)
+{
+    int i;
+    for (i = 0; i < N; i += VNNI_BLOCK) {
+        __mmask16 mask = TAIL_MASK16(N - i);
+        __m512 x_v = _mm512_maskz_loadu_ps(mask, &x[i]);
+        float max = _mm512_reduce_max_ps(_mm512_abs_ps(x_v));
+        float scale = max > 0 ? 127.f / max : 1.f;
+        __m512i q_v = _mm512_cvtps_epi32(_mm512_mul_ps(x_v, _mm512_set1_ps(scale)));
+        _mm512_mask_cvtepi32_storeu_epi8(&q[i], mask, _mm512_add_epi32(q_v, _mm512_set1_epi32(128)));
+        inv_scale[i / VNNI_BLOCK] = 1.f / scale;
+    }
+    for (i = N; i % VNNI_BLOCK; i++)
+        q[i] = 128;
+}
+
+/* out[i] += w[.][col0 + i].x for i < cols, with x quantized by quantize_u8().
+   The 128 offset of x is removed using the per-block weight sums, which also
+   cancels the rows of a partial block that x does not cover. */
+static RNN_ALWAYS_INLINE void matvec_vnni(float *out, const rnn_weight *w, const int *w_sum, int stride,
+                                          int col0, int cols, const unsigned char *x, const float *inv_scale, int M)
+{
+    int i, j, b;
+    int blocks = (M + VNNI_BLOCK - 1) / VNNI_BLOCK;
+    for (i = 0; i < cols; i += 16) {
+        __mmask16 mask = TAIL_MASK16(cols - i);
+        const rnn_weight *wp = &w[4 * (col0 + i)];
+        __m512 out_v = _mm512_maskz_loadu_ps(mask, &out[i]);
+        for (b = 0; b < blocks; b++) {
+            __m512i acc = _mm512_setzero_si512();
+            __m512i offset = _mm512_slli_epi32(_mm512_maskz_loadu_epi32(mask, &w_sum[b * stride + col0 + i]), 7);
+            for (j = b * (VNNI_BLOCK / 4); j < (b + 1) * (VNNI_BLOCK / 4); j++) {
+                int x4;
+                memcpy(&x4, &x[4 * j], 4);
+                acc = _mm512_dpbusd_epi32(acc, _mm512_set1_epi32(x4), _mm512_maskz_loadu_epi32(mask, &wp[4 * j * stride]));
+            }
+            acc = _mm512_sub_epi32(acc, offset);
+            out_v = _mm512_fmadd_ps(_mm512_cvtepi32_ps(acc), _mm512_set1_ps(inv_scale[b]), out_v);
+        }
+        _mm512_mask_storeu_ps(&out[i], mask, out_v);
+    }
+}
+
+static RNN_ALWAYS_INLINE void gru_vnni(const GRULayer* gru, float* state, const float* input,
+                                       int nb_inputs, const float* input_sum, int N, int activation)
+{
+    int M;
+    int stride;
+    float sum[3 * MAX_NEURONS];
+    float rs[MAX_NEURONS];
+    float *z, *h;
+    unsigned char x[VNNI_MAX_BLOCKS * VNNI_BLOCK];
+    float inv_scale[VNNI_MAX_BLOCKS];
+    M = nb_inputs;
+    stride = 3 * N;
+    z = sum;
+    h = &sum[2 * N];
+
+    init_gate_sums(sum, gru->bias, input_sum, N);
+    quantize_u8(x, inv_scale, input, M);
+    matvec_vnni(sum, gru->input_weights_vnni, gru->input_weights_sum, stride, 0, stride, x, inv_scale, M);
+    quantize_u8(x, inv_scale, state, N);
+    matvec_vnni(sum, gru->recurrent_weights_vnni, gru->recurrent_weights_sum, stride, 0, 2 * N, x, inv_scale, N);
+    gru_gates_avx512(z, rs, sum, state, N);
+
+    /* Compute output. */
+    quantize_u8(x, inv_scale, rs, N);
+    matvec_vnni(h, gru->recurrent_weights_vnni, gru->recurrent_weights_sum, stride, 2 * N, N, x, inv_scale, N);
+    scale_and_activate_avx512(h, N, activation);
+    gru_blend_avx512(state, z, h, N);
+}
+
+DEFINE_GRU_KERNEL(compute_gru_vnni, gru_vnni)
+
+/* Regroups a [rows][cols] weight matrix as [rows/4][cols][4] for vpdpbusd,
+   zero-padded to whole blocks, and sums each column over every block. */
+static rnn_weight *pack_weights_vnni(const rnn_weight *w, int rows, int cols, int **w_sum)
+{
+    int i, j;
+    int blocks = (rows + VNNI_BLOCK - 1) / VNNI_BLOCK;
+    rnn_weight *packed = calloc(blocks * VNNI_BLOCK * cols, sizeof(rnn_weight));
+    int *sums = calloc(blocks * cols, sizeof(int));
+    if (packed == NULL || sums == NULL) {
+        free(packed);
+        free(sums);
+        return NULL;
+    }
+    for (j = 0; j < rows; j++) {
+        for (i = 0; i < cols; i++) {
+            packed[4 * ((j / 4) * cols + i) + (j % 4)] = w[j * cols + i];
+            sums[(j / VNNI_BLOCK) * cols + i] += w[j * cols + i];
+        }
+    }
+    *w_sum = sums;
+    return packed;
+}
+
+static GRULayer *prepare_gru_vnni(const GRULayer *gru)
+{
+    GRULayer *ret = malloc(sizeof(GRULayer));
+    int *input_sum = NULL, *recurrent_sum = NULL;
+    if (ret == NULL)
+        return NULL;
+    *ret = *gru;
+    ret->input_weights_vnni = pack_weights_vnni(gru->input_weights, gru->nb_inputs, 3 * gru->nb_neurons, &input_sum);
+    ret->recurrent_weights_vnni = pack_weights_vnni(gru->recurrent_weights, gru->nb_neurons, 3 * gru->nb_neurons, &recurrent_sum);
+    ret->input_weights_sum = input_sum;
+    ret->recurrent_weights_sum = recurrent_sum;
+    return ret;
+}
+#endif
+
+static void free_kernel_layer(const GRULayer *layer, const GRULayer *model_layer)
+{
+    if (layer == NULL || layer == model_layer)
+        return;
+    free((void*)layer->input_weights_vnni);
+    free((void*)layer->recurrent_weights_vnni);
+    free((void*)layer->input_weights_sum);
+    free((void*)layer->recurrent_weights_sum);
+    free((void*)layer);
+}
+
+/* Stacks the rows of input_dense, noise_gru and denoise_gru that multiply the
+   features side by side, so that their projections take a single sweep. */
+static void init_feature_weights(RNNState *rnn)
+{
+    const DenseLayer *dense = rnn->model->input_dense;
+    const GRULayer *noise = rnn->model->noise_gru;
+    const GRULayer *denoise = rnn->model->denoise_gru;
+    int noise_cols = 3 * noise->nb_neurons;
+    int denoise_cols = 3 * denoise->nb_neurons;
+    int cols = dense->nb_neurons + noise_cols + denoise_cols;
+    rnn_weight *weights, *bias;
+    int j;
+
+    rnn->feature_weights = NULL;
+    rnn->feature_bias = NULL;
+    rnn->feature_cols = 0;
+    if (dense->nb_inputs != INPUT_SIZE || noise->nb_inputs < INPUT_SIZE || denoise->nb_inputs < INPUT_SIZE
+        || cols > MAX_FEATURE_COLS)
+        return;
+    /* Pruned layers are cheaper to run on their own blocks */
+    if (noise->input_weights_sparse || denoise->input_weights_sparse)
+        return;
+    weights = malloc(INPUT_SIZE * cols * sizeof(rnn_weight));
+    bias = malloc(cols * sizeof(rnn_weight));
+    if (weights == NULL || bias == NULL) {
+        free(weights);
+        free(bias);
+        return;
+    }
+    for (j = 0; j < INPUT_SIZE; j++) {
+        rnn_weight *row = &weights[j * cols];
+        memcpy(row, &dense->input_weights[j * dense->nb_neurons], dense->nb_neurons * sizeof(rnn_weight));
+        row += dense->nb_neurons;
+        memcpy(row, &noise->input_weights[(noise->nb_inputs - INPUT_SIZE + j) * noise_cols], noise_cols * sizeof(rnn_weight));
+        row += noise_cols;
+        memcpy(row, &denoise->input_weights[(denoise->nb_inputs - INPUT_SIZE + j) * denoise_cols], denoise_cols * sizeof(rnn_weight));
+    }
+    memcpy(bias, dense->bias, dense->nb_neurons * sizeof(rnn_weight));
+    memcpy(&bias[dense->nb_neurons], noise->bias, noise_cols * sizeof(rnn_weight));
+    memcpy(&bias[dense->nb_neurons + noise_cols], denoise->bias, denoise_cols * sizeof(rnn_weight));
+    rnn->feature_weights = weights;
+    rnn->feature_bias = bias;
+    rnn->feature_cols = cols;
+}
+
+#if defined(RNN_AVX512)
+static int is_sparse_gru(const GRULayer *gru)
+{
+    return gru->input_weights_sparse != NULL || gru->recurrent_weights_sparse != NULL;
+}
+#endif
+
+void rnn_init_generic_kernels(RNNState *rnn)
+{
+    rnn->vad_gru = rnn->model->vad_gru;
+    rnn->noise_gru = rnn->model->noise_gru;
+    rnn->denoise_gru = rnn->model->denoise_gru;
+#if defined(RNN_INT_NETWORK)
+    /* The integer path reads the dense weights of the model directly */
+    return;
+#endif
+    rnn->compute_gru_fct = &compute_gru;
+    rnn->compute_dense_fct = &compute_dense;
+    rnn->matvec_fct = &accumulate_matvec;
+    init_feature_weights(rnn);
+}
+
+void rnn_init_kernels(RNNState *rnn)
+{
+#if defined(RNN_AVX512)
+    /* Only the AVX2 GRU kernel runs block-sparse weights */
+    int sparse = is_sparse_gru(rnn->model->vad_gru) || is_sparse_gru(rnn->model->noise_gru)
+        || is_sparse_gru(rnn->model->denoise_gru);
+#endif
+
+    rnn_init_generic_kernels(rnn);
+#if defined(RNN_INT_NETWORK)
+    return;
+#endif
+
+#if defined(__AVX2__)
+    if (is_avx2_supported() == 1) {
+        rnn->compute_gru_fct = &compute_gru_avx2;
+        rnn->compute_dense_fct = &compute_dense_avx2;
+        rnn->matvec_fct = &accumulate_matvec_avx2;
+    }
+#endif
+
+#if defined(RNN_AVX512)
+    if (is_avx512_supported() == 1) {
+        if (!sparse)
+            rnn->compute_gru_fct = &compute_gru_avx512;
+        rnn->compute_dense_fct = &compute_dense_avx512;
+        rnn->matvec_fct = &accumulate_matvec_avx512;
+    }
+#endif
+
+#if defined(RNN_AVX512_VNNI)
+    if (is_avx512_vnni_supported() == 1 && !sparse) {
+        GRULayer *vad_gru = prepare_gru_vnni(rnn->model->vad_gru);
+        GRULayer *noise_gru = prepare_gru_vnni(rnn->model->noise_gru);
+        GRULayer *denoise_gru = prepare_gru_vnni(rnn->model->denoise_gru);
+        if (vad_gru && vad_gru->input_weights_vnni && vad_gru->recurrent_weights_vnni &&
+            noise_gru && noise_gru->input_weights_vnni && noise_gru->recurrent_weights_vnni &&
+            denoise_gru && denoise_gru->input_weights_vnni && denoise_gru->recurrent_weights_vnni) {
+            rnn->vad_gru = vad_gru;
+            rnn->noise_gru = noise_gru;
+            rnn->denoise_gru = denoise_gru;
+            rnn->compute_gru_fct = &compute_gru_vnni;
+        } else {
+            /* Out of memory: stay on the float kernels */
+            free_kernel_layer(vad_gru, NULL);
+            free_kernel_layer(noise_gru, NULL);
+            free_kernel_layer(denoise_gru, NULL);
+        }
+    }
+#endif
+}
+
+void rnn_free_kernels(RNNState *rnn)
+{
+    if (rnn->model == NULL)
+        return;
+    free(rnn->feature_weights);
+    free(rnn->feature_bias);
+    free_kernel_layer(rnn->vad_gru, rnn->model->vad_gru);
+    free_kernel_layer(rnn->noise_gru, rnn->model->noise_gru);
+    free_kernel_layer(rnn->denoise_gru, rnn->model->denoise_gru);
+}
+
+
+#if defined(RNN_STATE_FP16) || defined(RNN_STATE_BF16)
+typedef union {
+    float f;
+    opus_uint32 u;
+} float_bits;
+#endif
+
+#if defined(RNN_STATE_FP16)
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define RNN_F16C 1
+#endif
+
+/* IEEE half precision conversions with round-to-nearest-even, for CPUs or
+   builds without F16C. */
+static OPUS_INLINE float half_to_float(unsigned short h)
+{
+    float_bits v;
+    opus_uint32 exponent = (h >> 10) & 0x1f;
+    opus_uint32 mantissa = h & 0x3ff;
+    if (exponent == 0) {
+        v.f = mantissa * (1.f / 16777216.f);
+    } else if (exponent == 31) {
+        v.u = 0x7f800000u | (mantissa << 13);
+    } else {
+        v.u = ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    v.u |= (opus_uint32)(h & 0x8000) << 16;
+    return v.f;
+}
+
+static OPUS_INLINE unsigned short float_to_half(float f)
+{
+    float_bits v;
+    opus_uint32 sign;
+    unsigned short h;
+    v.f = f;
+    sign = v.u & 0x80000000u;
+    v.u ^= sign;
+    if (v.u >= 0x47800000u) {
+        /* Overflow to infinity, NaN stays NaN */
+        h = v.u > 0x7f800000u ? 0x7e00 : 0x7c00;
+    } else if (v.u < 0x38800000u) {
+        /* Subnormal or zero: let the float adder do the rounding */
+        float_bits magic;
+        magic.u = 0x3f000000u;
+        v.f += magic.f;
+        h = (unsigned short)(v.u - magic.u);
+    } else {
+        opus_uint32 odd = (v.u >> 13) & 1;
+        v.u += 0xc8000fffu + odd;
+        h = (unsigned short)(v.u >> 13);
+    }
+    return h | (unsigned short)(sign >> 16);
+}
+
+static void load_state(float *dst, const rnn_state *src, int N)
+{
+    int i = 0;
+#if defined(RNN_F16C)
+    for (; i + 8 <= N; i += 8)
+        _mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&src[i])));
+#endif
+    for (; i < N; i++)
+        dst[i] = half_to_float(src[i]);
+}
+
+static void store_state(rnn_state *dst, const float *src, int N)
+{
+    int i = 0;
+#if defined(RNN_F16C)
+    for (; i + 8 <= N; i += 8)
+        _mm_storeu_si128((__m128i*)&dst[i], _mm256_cvtps_ph(_mm256_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < N; i++)
+        dst[i] = float_to_half(src[i]);
+}
+#elif defined(RNN_STATE_BF16)
+/* bfloat16 is the top half of a float; stores round to nearest even. */
+static void load_state(float *dst, const rnn_state *src, int N)
+{
+    int i;
+    for (i = 0; i < N; i++) {
+        float_bits v;
+        v.u = (opus_uint32)src[i] << 16;
+        dst[i] = v.f;
+    }
+}
+
+static void store_state(rnn_state *dst, const float *src, int N)
+{
+    int i;
+    for (i = 0; i < N; i++) {
+        float_bits v;
+        v.f = src[i];
+        if ((v.u & 0x7fffffffu) > 0x7f800000u)
+            dst[i] = (rnn_state)((v.u >> 16) | 0x40);
+        else
+            dst[i] = (rnn_state)((v.u + 0x7fff + ((v.u >> 16) & 1)) >> 16);
+    }
+}
+#endif
+
+#if defined(FIXED_POINT) && !defined(RNN_INT_NETWORK)
+#error "The FIXED_POINT build runs the network in integer arithmetic, define RNN_INT_NETWORK"
+#endif
+
+#if !defined(RNN_INT_NETWORK)
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
     int i;
+    int noise_inputs, denoise_inputs;
     float dense_out[MAX_NEURONS];
     float noise_input[MAX_NEURONS * 3];
     float denoise_input[MAX_NEURONS * 3];
-    compute_dense(rnn->model->input_dense, dense_out, input);
-    rnn->compute_gru_fct(rnn->model->vad_gru, rnn->vad_gru_state, dense_out);
-    compute_dense(rnn->model->vad_output, vad, rnn->vad_gru_state);
+    float feature_sum[MAX_FEATURE_COLS];
+    const float *noise_sum = NULL;
+    const float *denoise_sum = NULL;
+#if defined(RNN_STATE_FP16) || defined(RNN_STATE_BF16)
+    float vad_gru_state[MAX_NEURONS];
+    float noise_gru_state[MAX_NEURONS];
+    float denoise_gru_state[MAX_NEURONS];
+    load_state(vad_gru_state, rnn->vad_gru_state, rnn->model->vad_gru_size);
+    load_state(noise_gru_state, rnn->noise_gru_state, rnn->model->noise_gru_size);
+    load_state(denoise_gru_state, rnn->denoise_gru_state, rnn->model->denoise_gru_size);
+#else
+    float *vad_gru_state = rnn->vad_gru_state;
+    float *noise_gru_state = rnn->noise_gru_state;
+    float *denoise_gru_state = rnn->denoise_gru_state;
+#endif
+    if (rnn->feature_weights) {
+        /* All the feature projections up front; the GRUs then only read the
+           outputs of the other layers. */
+        for (i = 0;i < rnn->feature_cols;i++) feature_sum[i] = rnn->feature_bias[i];
+        rnn->matvec_fct(feature_sum, rnn->feature_weights, rnn->feature_cols, rnn->feature_cols, input, INPUT_SIZE);
+        for (i = 0;i < rnn->model->input_dense_size;i++) dense_out[i] = WEIGHTS_SCALE * feature_sum[i];
+        compute_activation(dense_out, rnn->model->input_dense_size, rnn->model->input_dense->activation);
+        noise_sum = &feature_sum[rnn->model->input_dense_size];
+        denoise_sum = &noise_sum[3 * rnn->model->noise_gru_size];
+    } else {
+        rnn->compute_dense_fct(rnn->model->input_dense, dense_out, input);
+    }
+    noise_inputs = rnn->noise_gru->nb_inputs - (noise_sum ? INPUT_SIZE : 0);
+    denoise_inputs = rnn->denoise_gru->nb_inputs - (denoise_sum ? INPUT_SIZE : 0);
+
+    rnn->compute_gru_fct(rnn->vad_gru, vad_gru_state, dense_out, rnn->vad_gru->nb_inputs, NULL);
+    if (vad)
+        rnn->compute_dense_fct(rnn->model->vad_output, vad, vad_gru_state);
     for (i = 0;i < rnn->model->input_dense_size;i++) noise_input[i] = dense_out[i];
-    for (i = 0;i < rnn->model->vad_gru_size;i++) noise_input[i + rnn->model->input_dense_size] = rnn->vad_gru_state[i];
+    for (i = 0;i < rnn->model->vad_gru_size;i++) noise_input[i + rnn->model->input_dense_size] = vad_gru_state[i];
     for (i = 0;i < INPUT_SIZE;i++) noise_input[i + rnn->model->input_dense_size + rnn->model->vad_gru_size] = input[i];
-    rnn->compute_gru_fct(rnn->model->noise_gru, rnn->noise_gru_state, noise_input);
+    rnn->compute_gru_fct(rnn->noise_gru, noise_gru_state, noise_input, noise_inputs, noise_sum);
 
-    for (i = 0;i < rnn->model->vad_gru_size;i++) denoise_input[i] = rnn->vad_gru_state[i];
-    for (i = 0;i < rnn->model->noise_gru_size;i++) denoise_input[i + rnn->model->vad_gru_size] = rnn->noise_gru_state[i];
+    for (i = 0;i < rnn->model->vad_gru_size;i++) denoise_input[i] = vad_gru_state[i];
+    for (i = 0;i < rnn->model->noise_gru_size;i++) denoise_input[i + rnn->model->vad_gru_size] = noise_gru_state[i];
     for (i = 0;i < INPUT_SIZE;i++) denoise_input[i + rnn->model->vad_gru_size + rnn->model->noise_gru_size] = input[i];
-    rnn->compute_gru_fct(rnn->model->denoise_gru, rnn->denoise_gru_state, denoise_input);
-    compute_dense(rnn->model->denoise_output, gains, rnn->denoise_gru_state);
+    rnn->compute_gru_fct(rnn->denoise_gru, denoise_gru_state, denoise_input, denoise_inputs, denoise_sum);
+    rnn->compute_dense_fct(rnn->model->denoise_output, gains, denoise_gru_state);
+#if defined(RNN_STATE_FP16) || defined(RNN_STATE_BF16)
+    store_state(rnn->vad_gru_state, vad_gru_state, rnn->model->vad_gru_size);
+    store_state(rnn->noise_gru_state, noise_gru_state, rnn->model->noise_gru_size);
+    store_state(rnn->denoise_gru_state, denoise_gru_state, rnn->model->denoise_gru_size);
+#endif
+}
+
+#else
+/* Integer inference of the network. Without FIXED_POINT the features still
+   come from the float analysis in denoise.c and the outputs go back to float.
+   Layer outputs, features and recurrent states are Q10 in 16 bits (+/-32,
+   enough for the relu states and the first cepstral bands), the update and
+   reset gates are Q15. The int8 weights are multiplied with them into 32-bit
+   sums where the bias is Q10 * 256. */
+#define Q_ACT 10
+#define Q_ACT_MAX 32767
+
+static OPUS_INLINE opus_int16 sat16(opus_int32 x)
+{
+    return (opus_int16)(x > 32767 ? 32767 : (x < -32768 ? -32768 : x));
+}
+
+/* Sum scaled by WEIGHTS_SCALE, to Q10 */
+static OPUS_INLINE opus_int32 sum_to_q10(opus_int32 sum)
+{
+    return (sum + 128) >> 8;
 }
+
+/* tanh of a Q10 value, in Q15 */
+static OPUS_INLINE opus_int32 tansig_q15(opus_int32 x)
+{
+    opus_int32 i, frac, y;
+    opus_int32 sign = 1;
+    if (x < 0) {
+        x = -x;
+        sign = -1;
+    }
+    if (x >= 8 << Q_ACT)
+        return sign * 32767;
+    i = x >> 5;
+    frac = x & 31;
+    y = tansig_table_q15[i] + (((tansig_table_q15[i + 1] - tansig_table_q15[i]) * frac + 16) >> 5);
+    return sign * y;
+}
+
+static OPUS_INLINE opus_int32 sigmoid_q15(opus_int32 x)
+{
+    return (32768 + tansig_q15(x >> 1)) >> 1;
+}
+
+static OPUS_INLINE opus_int16 activation_q10(opus_int32 x, int activation)
+{
+    if (activation == ACTIVATION_SIGMOID)
+        return (opus_int16)((sigmoid_q15(x) + 16) >> 5);
+    if (activation == ACTIVATION_TANH)
+        return (opus_int16)((tansig_q15(x) + 16) >> 5);
+    return x < 0 ? 0 : (opus_int16)(x > Q_ACT_MAX ? Q_ACT_MAX : x);
+}
+
+#if defined(FIXED_POINT)
+/* The gains and the VAD stay in Q15 for the fixed-point synthesis */
+static OPUS_INLINE opus_val16 activation_out(opus_int32 x, int activation)
+{
+    if (activation == ACTIVATION_SIGMOID)
+        return (opus_val16)sigmoid_q15(x);
+    if (activation == ACTIVATION_TANH)
+        return (opus_val16)tansig_q15(x);
+    return x < 0 ? 0 : sat16(x << (15 - Q_ACT));
+}
+#else
+static OPUS_INLINE float activation_out(opus_int32 x, int activation)
+{
+    if (activation == ACTIVATION_SIGMOID)
+        return sigmoid_q15(x) * (1.f / 32768);
+    if (activation == ACTIVATION_TANH)
+        return tansig_q15(x) * (1.f / 32768);
+    return x < 0 ? 0.f : x * (1.f / (1 << Q_ACT));
+}
+#endif
+
+/* out[i] += sum_j w[j*stride + i] * x[j] for i < cols. Plain loops the compiler
+   vectorizes into 16-bit multiplies with 32-bit accumulation. */
+static void matvec_q(opus_int32 *out, const rnn_weight *w, int stride, int cols, const opus_int16 *x, int M)
+{
+    int i, j;
+    for (j = 0; j < M; j++) {
+        const rnn_weight *row = &w[j * stride];
+        opus_int32 xj = x[j];
+        for (i = 0; i < cols; i++)
+            out[i] += row[i] * xj;
+    }
+}
+
+/* Pre-activation outputs of a dense layer, in Q10 */
+static void compute_dense_q(const DenseLayer *layer, opus_int32 *output, const opus_int16 *input)
+{
+    int i;
+    int N = layer->nb_neurons;
+    opus_int32 sum[MAX_NEURONS];
+    for (i = 0; i < N; i++)
+        sum[i] = (opus_int32)layer->bias[i] << Q_ACT;
+    matvec_q(sum, layer->input_weights, N, N, input, layer->nb_inputs);
+    for (i = 0; i < N; i++)
+        output[i] = sum_to_q10(sum[i]);
+}
+
+static void compute_gru_q(const GRULayer *gru, opus_int16 *state, const opus_int16 *input)
+{
+    int i;
+    int N = gru->nb_neurons;
+    int stride = 3 * N;
+    opus_int32 sum[3 * MAX_NEURONS];
+    opus_int16 z[MAX_NEURONS];
+    opus_int16 rs[MAX_NEURONS];
+    for (i = 0; i < 3 * N; i++)
+        sum[i] = (opus_int32)gru->bias[i] << Q_ACT;
+    matvec_q(sum, gru->input_weights, stride, stride, input, gru->nb_inputs);
+    matvec_q(sum, gru->recurrent_weights, stride, 2 * N, state, N);
+    for (i = 0; i < N; i++) {
+        opus_int32 r = sigmoid_q15(sum_to_q10(sum[N + i]));
+        z[i] = (opus_int16)sigmoid_q15(sum_to_q10(sum[i]));
+        rs[i] = (opus_int16)((state[i] * r + 16384) >> 15);
+    }
+    matvec_q(&sum[2 * N], &gru->recurrent_weights[2 * N], stride, N, rs, N);
+    for (i = 0; i < N; i++) {
+        opus_int32 h = activation_q10(sum_to_q10(sum[2 * N + i]), gru->activation);
+        state[i] = sat16(h + ((z[i] * (state[i] - h) + 16384) >> 15));
+    }
+}
+
+void compute_rnn(RNNState *rnn, opus_val16 *gains, opus_val16 *vad, const opus_val16 *input) {
+    int i;
+    const RNNModel *model = rnn->model;
+    opus_int16 dense_out[MAX_NEURONS];
+    opus_int16 noise_input[MAX_NEURONS * 3];
+    opus_int16 denoise_input[MAX_NEURONS * 3];
+    opus_int32 sum[MAX_NEURONS];
+#if defined(FIXED_POINT)
+    const opus_int16 *features = input;
+#else
+    opus_int16 features[INPUT_SIZE];
+    /* The features come from the float analysis */
+    for (i = 0;i < INPUT_SIZE;i++)
+        features[i] = sat16((opus_int32)floor(.5f + input[i] * (1 << Q_ACT)));
+#endif
+
+    compute_dense_q(model->input_dense, sum, features);
+    for (i = 0;i < model->input_dense_size;i++) dense_out[i] = activation_q10(sum[i], model->input_dense->activation);
+    compute_gru_q(model->vad_gru, rnn->vad_gru_state, dense_out);
+    if (vad) {
+        compute_dense_q(model->vad_output, sum, rnn->vad_gru_state);
+        for (i = 0;i < model->vad_output_size;i++) vad[i] = activation_out(sum[i], model->vad_output->activation);
+    }
+
+    for (i = 0;i < model->input_dense_size;i++) noise_input[i] = dense_out[i];
+    for (i = 0;i < model->vad_gru_size;i++) noise_input[i + model->input_dense_size] = rnn->vad_gru_state[i];
+    for (i = 0;i < INPUT_SIZE;i++) noise_input[i + model->input_dense_size + model->vad_gru_size] = features[i];
+    compute_gru_q(model->noise_gru, rnn->noise_gru_state, noise_input);
+
+    for (i = 0;i < model->vad_gru_size;i++) denoise_input[i] = rnn->vad_gru_state[i];
+    for (i = 0;i < model->noise_gru_size;i++) denoise_input[i + model->vad_gru_size] = rnn->noise_gru_state[i];
+    for (i = 0;i < INPUT_SIZE;i++) denoise_input[i + model->vad_gru_size + model->noise_gru_size] = features[i];
+    compute_gru_q(model->denoise_gru, rnn->denoise_gru_state, denoise_input);
+    compute_dense_q(model->denoise_output, sum, rnn->denoise_gru_state);
+    for (i = 0;i < model->denoise_output_size;i++) gains[i] = activation_out(sum[i], model->denoise_output->activation);
+}
+#endif
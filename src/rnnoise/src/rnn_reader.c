@@ -42,11 +42,81 @@
 #define F_ACTIVATION_SIGMOID    1
 #define F_ACTIVATION_RELU       2
 
+/* Version 2 precedes each GRU weight matrix with a format flag: 0 for a dense
+ * matrix as in version 1, or 1 for a block-sparse one. A block-sparse matrix
+ * lists, for each group of 8 outputs, its number of 4x8 blocks followed by the
+ * first input of each block (a multiple of 4), and then the 32 weights of every
+ * block in the same order, input by input. */
+#define F_MATRIX_DENSE          0
+#define F_MATRIX_SPARSE         1
+
+static int read_int(FILE *f, int min, int max, int *value)
+{
+    return fscanf(f, "%d", value) == 1 && *value >= min && *value <= max;
+}
+
+/* Reads a block-sparse rows x cols matrix. The dense matrix is rebuilt as well,
+ * for the kernels that do not handle sparse weights. */
+static int read_sparse_matrix(FILE *f, int rows, int cols, const rnn_weight **dense,
+                              const int **block_offset, const int **block_rows, const rnn_weight **sparse)
+{
+    int groups = cols / SPARSE_BLOCK_OUTPUTS;
+    int max_blocks = groups * ((rows + SPARSE_BLOCK_INPUTS - 1) / SPARSE_BLOCK_INPUTS);
+    int block_size = SPARSE_BLOCK_INPUTS * SPARSE_BLOCK_OUTPUTS;
+    rnn_weight *weights = calloc(rows * cols, sizeof(rnn_weight));
+    int *offset = malloc((groups + 1) * sizeof(int));
+    int *row_list = malloc(max_blocks * sizeof(int));
+    rnn_weight *values = NULL;
+    int g, b, k, nb_blocks = 0;
+
+    /* Hand the allocations over first so that the caller frees them on error */
+    *dense = weights;
+    *block_offset = offset;
+    *block_rows = row_list;
+    if (!weights || !offset || !row_list || cols % SPARSE_BLOCK_OUTPUTS)
+        return 0;
+
+    for (g = 0; g < groups; g++) {
+        int count;
+        offset[g] = nb_blocks;
+        if (!read_int(f, 0, max_blocks / groups, &count))
+            return 0;
+        for (b = 0; b < count; b++) {
+            if (!read_int(f, 0, rows - 1, &row_list[nb_blocks]) || row_list[nb_blocks] % SPARSE_BLOCK_INPUTS)
+                return 0;
+            nb_blocks++;
+        }
+    }
+    offset[groups] = nb_blocks;
+
+    values = calloc(nb_blocks * block_size + 1, sizeof(rnn_weight));
+    *sparse = values;
+    if (!values)
+        return 0;
+    for (g = 0; g < groups; g++) {
+        for (b = offset[g]; b < offset[g + 1]; b++) {
+            for (k = 0; k < block_size; k++) {
+                int row = row_list[b] + k / SPARSE_BLOCK_OUTPUTS;
+                int col = g * SPARSE_BLOCK_OUTPUTS + k % SPARSE_BLOCK_OUTPUTS;
+                int in;
+                if (!read_int(f, -128, 127, &in))
+                    return 0;
+                /* Blocks overhanging the last input keep zeros there */
+                if (row < rows) {
+                    values[b * block_size + k] = in;
+                    weights[row * cols + col] = in;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
 RNNModel *rnnoise_model_from_file(FILE *f)
 {
-    int i, in;
+    int i, in, version;
 
-    if (fscanf(f, "rnnoise-nu model file version %d\n", &in) != 1 || in != 1)
+    if (fscanf(f, "rnnoise-nu model file version %d\n", &version) != 1 || version < 1 || version > 2)
         return NULL;
 
     RNNModel *ret = calloc(1, sizeof(RNNModel));
@@ -117,13 +187,31 @@ RNNModel *rnnoise_model_from_file(FILE *f)
     INPUT_ARRAY(name->bias, name->nb_neurons); \
     } while (0)
 
+#define INPUT_MATRIX(name, prefix, rows, cols) do { \
+    int format = F_MATRIX_DENSE; \
+    if (version >= 2) \
+        INPUT_VAL(format); \
+    if (format == F_MATRIX_SPARSE) { \
+        if (!read_sparse_matrix(f, rows, cols, &name->prefix ## _weights, &name->prefix ## _block_offset, \
+                                &name->prefix ## _block_rows, &name->prefix ## _weights_sparse)) { \
+            rnnoise_model_free(ret); \
+            return NULL; \
+        } \
+    } else if (format == F_MATRIX_DENSE) { \
+        INPUT_ARRAY(name->prefix ## _weights, (rows) * (cols)); \
+    } else { \
+        rnnoise_model_free(ret); \
+        return NULL; \
+    } \
+    } while (0)
+
 #define INPUT_GRU(name) do { \
     INPUT_VAL(name->nb_inputs); \
     INPUT_VAL(name->nb_neurons); \
     ret->name ## _size = name->nb_neurons; \
     INPUT_ACTIVATION(name->activation); \
-    INPUT_ARRAY(name->input_weights, name->nb_inputs * name->nb_neurons * 3); \
-    INPUT_ARRAY(name->recurrent_weights, name->nb_neurons * name->nb_neurons * 3); \
+    INPUT_MATRIX(name, input, name->nb_inputs, name->nb_neurons * 3); \
+    INPUT_MATRIX(name, recurrent, name->nb_neurons, name->nb_neurons * 3); \
     INPUT_ARRAY(name->bias, name->nb_neurons * 3); \
     } while (0)
 
@@ -152,6 +240,12 @@ void rnnoise_model_free(RNNModel *model)
         free((void *) model->name->input_weights); \
         free((void *) model->name->recurrent_weights); \
         free((void *) model->name->bias); \
+        free((void *) model->name->input_block_offset); \
+        free((void *) model->name->input_block_rows); \
+        free((void *) model->name->input_weights_sparse); \
+        free((void *) model->name->recurrent_block_offset); \
+        free((void *) model->name->recurrent_block_rows); \
+        free((void *) model->name->recurrent_weights_sparse); \
         free((void *) model->name); \
     } \
     } while (0)
@@ -0,0 +1,188 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Checks that the cached cepstral distances leave the spectral variability
+ * feature exactly as it was computed before the cache. After every frame of
+ * some audio, the cached distances are compared with a full recomputation
+ * from cepstral_mem, and the feature compute_frame_features() wrote with the
+ * one the brute-force 8x8x22 loop gives. Fails on any difference, they must
+ * be bit-exact.
+ *
+ * Usage: rnnoise_ceps_check [input.raw]
+ *
+ * input.raw is 48 kHz mono 16-bit PCM; a synthetic voice over noise is used
+ * otherwise. */
+
+/* The cache is internal to denoise.c */
+#include "denoise.c"
+
+#define SYNTHETIC_FRAMES 1000
+
+static float *synthetic_input(int *nb_frames)
+{
+    float *x = malloc(SYNTHETIC_FRAMES * FRAME_SIZE * sizeof(float));
+    unsigned seed = 1;
+    int i;
+    for (i = 0; i < SYNTHETIC_FRAMES * FRAME_SIZE; i++) {
+        float t = i / 48000.f;
+        float envelope = .5f + .5f * sinf(2 * M_PI * 3 * t);
+        float voice = 0;
+        int h;
+        for (h = 1; h <= 10; h++)
+            voice += sinf(2 * M_PI * 140 * h * t) / h;
+        seed = seed * 1664525u + 1013904223u;
+        x[i] = 4000 * envelope * voice + 2000 * ((seed >> 8) / 16777216.f - .5f);
+    }
+    *nb_frames = SYNTHETIC_FRAMES;
+    return x;
+}
+
+static float *read_input(const char *path, int *nb_frames)
+{
+    FILE *f = fopen(path, "rb");
+    short pcm[FRAME_SIZE];
+    float *x = NULL;
+    int n = 0;
+    if (!f)
+        return NULL;
+    while (fread(pcm, sizeof(short), FRAME_SIZE, f) == FRAME_SIZE) {
+        int i;
+        x = realloc(x, (n + 1) * FRAME_SIZE * sizeof(float));
+        for (i = 0; i < FRAME_SIZE; i++)
+            x[n * FRAME_SIZE + i] = pcm[i];
+        n++;
+    }
+    fclose(f);
+    *nb_frames = n;
+    return x;
+}
+
+/* The distance between two rows of cepstral_mem, as the feature computed it
+   before the cache */
+static opus_val32 brute_force_distance(const DenoiseState *st, int i, int j)
+{
+    opus_val32 dist = 0;
+    int k;
+    for (k = 0; k < NB_BANDS; k++) {
+        opus_val16 tmp;
+        tmp = EXTRACT16(SATURATE(st->cepstral_mem[i][k] - st->cepstral_mem[j][k], 32767));
+        dist = ADD32(dist, SHR32(MULT16_16(tmp, tmp), 4));
+    }
+    return dist;
+}
+
+/* The number of cached distances that differ from the recomputed ones */
+static int check_distances(const DenoiseState *st)
+{
+    int errors = 0;
+    int i, j;
+    for (i = 0; i < CEPS_MEM; i++) {
+        for (j = 0; j < CEPS_MEM; j++) {
+            if (j != i && st->cepstral_dist[i][j] != brute_force_distance(st, i, j))
+                errors++;
+        }
+    }
+    return errors;
+}
+
+/* The spectral variability feature as compute_frame_features() computed it
+   before the cache */
+static opus_val16 brute_force_variability(const DenoiseState *st)
+{
+    opus_val32 spec_variability = 0;
+    int i, j;
+    for (i = 0; i < CEPS_MEM; i++) {
+#ifdef FIXED_POINT
+        opus_val32 mindist = 2147483647;
+#else
+        float mindist = 1e15f;
+#endif
+        for (j = 0; j < CEPS_MEM; j++) {
+            opus_val32 dist = brute_force_distance(st, i, j);
+            if (j != i)
+                mindist = MIN32(mindist, dist);
+        }
+        spec_variability = ADD32(spec_variability, SHR32(mindist, 3));
+    }
+#ifdef FIXED_POINT
+    return SATURATE16(PSHR32(spec_variability, 16-10) - QCONST16(2.1f, 10));
+#else
+    return spec_variability/CEPS_MEM-2.1;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    DenoiseState *st;
+    float *x;
+    int nb_frames, checked = 0, distance_errors = 0, feature_errors = 0;
+    int i;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [input.raw]\n", argv[0]);
+        return 1;
+    }
+    x = argc == 2 ? read_input(argv[1], &nb_frames) : synthetic_input(&nb_frames);
+    if (!x || nb_frames == 0) {
+        fprintf(stderr, "no input audio\n");
+        return 1;
+    }
+
+    /* The analysis half of rnnoise_process_frame(), which keeps the features */
+    st = rnnoise_create(NULL);
+    for (i = 0; i < nb_frames; i++) {
+        kiss_fft_cpx X[FREQ_SIZE];
+        kiss_fft_cpx P[WINDOW_SIZE];
+        celt_sig in[FRAME_SIZE];
+        opus_val64 Ex[NB_BANDS], Ep[NB_BANDS];
+        opus_val16 Exp[NB_BANDS];
+        opus_val16 features[NB_FEATURES];
+        int silence, errors;
+        biquad_hp(in, st->mem_hp_x, &x[i * FRAME_SIZE], FRAME_SIZE, st->mode->hp_block);
+        silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, in);
+        errors = check_distances(st);
+        if (errors && !distance_errors)
+            fprintf(stderr, "frame %d: %d cached distances differ\n", i, errors);
+        distance_errors += errors;
+        /* Silent frames clear the features and leave the cepstra alone */
+        if (!silence) {
+            opus_val16 expected = brute_force_variability(st);
+            if (features[NB_BANDS+3*NB_DELTA_CEPS+1] != expected) {
+                if (!feature_errors)
+                    fprintf(stderr, "frame %d: spectral variability %.9g, expected %.9g\n", i,
+                            (double) features[NB_BANDS+3*NB_DELTA_CEPS+1], (double) expected);
+                feature_errors++;
+            }
+            checked++;
+        }
+    }
+    rnnoise_destroy(st);
+
+    printf("%d frames, %d differing distances, %d of %d spectral variability features differ\n",
+           nb_frames, distance_errors, feature_errors, checked);
+
+    free(x);
+    return distance_errors || feature_errors;
+}
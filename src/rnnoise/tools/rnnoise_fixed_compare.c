@@ -0,0 +1,240 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Checks the accuracy of the RNNOISE_FIXED_POINT build against the float one.
+ * Each build denoises the same audio with every built-in model and saves the
+ * output and the VAD, then the two results are compared: per model, the SNR
+ * of the fixed-point output against its difference from the float output, the
+ * mean VAD difference and the share of frames where the VAD lands on the other
+ * side of 0.5. Fails if the SNR is below MIN_SNR or the mean VAD difference
+ * above MAX_VAD_DIFF on any model.
+ *
+ * Usage: rnnoise_fixed_compare process <input.raw> <result.bin>
+ *        rnnoise_fixed_compare compare <float.bin> <fixed.bin>
+ *
+ * input.raw is 48 kHz mono 16-bit PCM. Run process with the tool of each
+ * build, then compare with either. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rnnoise.h"
+#include "rnnoise-nu.h"
+
+/* On near ties the fixed-point pitch search can settle on another multiple of
+   the period, which costs the most on steady hum (down to about 14 dB), and
+   the integer network alone moves the VAD by up to .025 on the noisiest
+   inputs. Overflows and scaling mistakes land far below either. */
+#define MIN_SNR 10.
+#define MAX_VAD_DIFF .04
+
+#define MODEL_NAME_SIZE 16
+
+typedef struct {
+    char name[MODEL_NAME_SIZE];
+    float *vad;
+    float *out;
+} ModelResult;
+
+typedef struct {
+    int nb_models;
+    int nb_frames;
+    int frame_size;
+    ModelResult *models;
+} Result;
+
+static short *read_input(const char *path, int frame_size, int *nb_frames)
+{
+    FILE *f = fopen(path, "rb");
+    short *pcm = NULL;
+    int n = 0;
+    if (!f)
+        return NULL;
+    for (;;) {
+        pcm = realloc(pcm, (n + 1) * frame_size * sizeof(short));
+        if (fread(&pcm[n * frame_size], sizeof(short), frame_size, f) != (size_t) frame_size)
+            break;
+        n++;
+    }
+    fclose(f);
+    *nb_frames = n;
+    return pcm;
+}
+
+static int process(const char *input, const char *output)
+{
+    const char **models = rnnoise_models();
+    int frame_size = rnnoise_get_frame_size();
+    int nb_frames, nb_models = 0;
+    short *pcm;
+    float *in, *out, *vad;
+    FILE *f;
+    int i, m;
+
+    pcm = read_input(input, frame_size, &nb_frames);
+    if (!pcm || nb_frames == 0) {
+        fprintf(stderr, "no input audio\n");
+        free(pcm);
+        return 1;
+    }
+    f = fopen(output, "wb");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", output);
+        free(pcm);
+        return 1;
+    }
+    while (models[nb_models])
+        nb_models++;
+    fwrite(&nb_models, sizeof(int), 1, f);
+    fwrite(&nb_frames, sizeof(int), 1, f);
+    fwrite(&frame_size, sizeof(int), 1, f);
+
+    in = malloc(frame_size * sizeof(float));
+    out = malloc(nb_frames * frame_size * sizeof(float));
+    vad = malloc(nb_frames * sizeof(float));
+    for (m = 0; m < nb_models; m++) {
+        DenoiseState *st = rnnoise_create(rnnoise_get_model(models[m]));
+        char name[MODEL_NAME_SIZE] = {0};
+        for (i = 0; i < nb_frames; i++) {
+            int j;
+            for (j = 0; j < frame_size; j++)
+                in[j] = pcm[i * frame_size + j];
+            vad[i] = rnnoise_process_frame(st, &out[i * frame_size], in);
+        }
+        rnnoise_destroy(st);
+        strncpy(name, models[m], MODEL_NAME_SIZE - 1);
+        fwrite(name, 1, MODEL_NAME_SIZE, f);
+        fwrite(vad, sizeof(float), nb_frames, f);
+        fwrite(out, sizeof(float), nb_frames * frame_size, f);
+    }
+    fclose(f);
+    free(in);
+    free(out);
+    free(vad);
+    free(pcm);
+    return 0;
+}
+
+static void free_result(Result *r)
+{
+    int m;
+    for (m = 0; m < r->nb_models; m++) {
+        free(r->models[m].vad);
+        free(r->models[m].out);
+    }
+    free(r->models);
+}
+
+static int read_result(const char *path, Result *r)
+{
+    FILE *f = fopen(path, "rb");
+    int m, ok;
+    memset(r, 0, sizeof(*r));
+    if (!f)
+        return 0;
+    ok = fread(&r->nb_models, sizeof(int), 1, f) == 1
+      && fread(&r->nb_frames, sizeof(int), 1, f) == 1
+      && fread(&r->frame_size, sizeof(int), 1, f) == 1
+      && r->nb_models > 0 && r->nb_frames > 0 && r->frame_size > 0;
+    if (ok)
+        r->models = calloc(r->nb_models, sizeof(ModelResult));
+    for (m = 0; ok && m < r->nb_models; m++) {
+        size_t samples = (size_t) r->nb_frames * r->frame_size;
+        ModelResult *model = &r->models[m];
+        model->vad = malloc(r->nb_frames * sizeof(float));
+        model->out = malloc(samples * sizeof(float));
+        ok = fread(model->name, 1, MODEL_NAME_SIZE, f) == MODEL_NAME_SIZE
+          && fread(model->vad, sizeof(float), r->nb_frames, f) == (size_t) r->nb_frames
+          && fread(model->out, sizeof(float), samples, f) == samples;
+        model->name[MODEL_NAME_SIZE - 1] = 0;
+    }
+    fclose(f);
+    if (!ok)
+        free_result(r);
+    return ok;
+}
+
+static int compare(const char *ref_path, const char *test_path)
+{
+    Result ref, test;
+    int failed = 0;
+    int m;
+
+    if (!read_result(ref_path, &ref)) {
+        fprintf(stderr, "cannot read %s\n", ref_path);
+        return 1;
+    }
+    if (!read_result(test_path, &test)) {
+        fprintf(stderr, "cannot read %s\n", test_path);
+        free_result(&ref);
+        return 1;
+    }
+    if (ref.nb_models != test.nb_models || ref.nb_frames != test.nb_frames || ref.frame_size != test.frame_size) {
+        fprintf(stderr, "the results are not from the same input\n");
+        free_result(&ref);
+        free_result(&test);
+        return 1;
+    }
+
+    for (m = 0; m < ref.nb_models; m++) {
+        const ModelResult *a = &ref.models[m];
+        const ModelResult *b = &test.models[m];
+        double signal = 0, noise = 0, vad_diff = 0, snr;
+        int flips = 0;
+        int i;
+        for (i = 0; i < ref.nb_frames * ref.frame_size; i++) {
+            signal += (double) a->out[i] * a->out[i];
+            noise += (double) (a->out[i] - b->out[i]) * (a->out[i] - b->out[i]);
+        }
+        for (i = 0; i < ref.nb_frames; i++) {
+            vad_diff += fabs(a->vad[i] - b->vad[i]);
+            flips += (a->vad[i] > .5f) != (b->vad[i] > .5f);
+        }
+        vad_diff /= ref.nb_frames;
+        snr = 10 * log10((signal + 1e-9) / (noise + 1e-9));
+        printf("%-5s SNR %6.2f dB, mean VAD difference %.4f, VAD flips in %.2f%% of frames\n",
+               a->name, snr, vad_diff, 100. * flips / ref.nb_frames);
+        failed |= snr < MIN_SNR || vad_diff > MAX_VAD_DIFF;
+    }
+    if (failed)
+        fprintf(stderr, "SNR below %.0f dB or VAD difference above %.2f\n", MIN_SNR, MAX_VAD_DIFF);
+
+    free_result(&ref);
+    free_result(&test);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && !strcmp(argv[1], "process"))
+        return process(argv[2], argv[3]);
+    if (argc == 4 && !strcmp(argv[1], "compare"))
+        return compare(argv[2], argv[3]);
+    fprintf(stderr, "usage: %s process <input.raw> <result.bin>\n", argv[0]);
+    fprintf(stderr, "       %s compare <float.bin> <fixed.bin>\n", argv[0]);
+    return 1;
+}
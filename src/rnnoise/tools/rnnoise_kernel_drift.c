@@ -0,0 +1,171 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Compares the kernels that rnn_init_kernels() picks on this CPU, the int8
+ * VNNI GRU and the AVX-512 or AVX2 float ones, with the C kernels, on every
+ * built-in model. Both networks get the same features from some audio, so
+ * only the kernels differ. Reports the largest band gain and VAD difference
+ * of each model and fails if one is above MAX_GAIN_DRIFT or MAX_VAD_DRIFT,
+ * both out of a 0 to 1 range.
+ *
+ * Usage: rnnoise_kernel_drift [input.raw]
+ *
+ * input.raw is 48 kHz mono 16-bit PCM; a synthetic voice over noise is used
+ * otherwise. Build with the target's -m flags to check its SIMD kernels. */
+
+/* The features and the network state are internal to denoise.c */
+#include "denoise.c"
+
+#include "rnnoise-nu.h"
+
+#define SYNTHETIC_FRAMES 1000
+#define MAX_GAIN_DRIFT .1
+#define MAX_VAD_DRIFT .1
+
+static float *synthetic_input(int *nb_frames)
+{
+    float *x = malloc(SYNTHETIC_FRAMES * FRAME_SIZE * sizeof(float));
+    unsigned seed = 1;
+    int i;
+    for (i = 0; i < SYNTHETIC_FRAMES * FRAME_SIZE; i++) {
+        float t = i / 48000.f;
+        float envelope = .5f + .5f * sinf(2 * M_PI * 3 * t);
+        float voice = 0;
+        int h;
+        for (h = 1; h <= 10; h++)
+            voice += sinf(2 * M_PI * 140 * h * t) / h;
+        seed = seed * 1664525u + 1013904223u;
+        x[i] = 4000 * envelope * voice + 2000 * ((seed >> 8) / 16777216.f - .5f);
+    }
+    *nb_frames = SYNTHETIC_FRAMES;
+    return x;
+}
+
+static float *read_input(const char *path, int *nb_frames)
+{
+    FILE *f = fopen(path, "rb");
+    short pcm[FRAME_SIZE];
+    float *x = NULL;
+    int n = 0;
+    if (!f)
+        return NULL;
+    while (fread(pcm, sizeof(short), FRAME_SIZE, f) == FRAME_SIZE) {
+        int i;
+        x = realloc(x, (n + 1) * FRAME_SIZE * sizeof(float));
+        for (i = 0; i < FRAME_SIZE; i++)
+            x[n * FRAME_SIZE + i] = pcm[i];
+        n++;
+    }
+    fclose(f);
+    *nb_frames = n;
+    return x;
+}
+
+static const char *gru_kernel_name(const RNNState *rnn)
+{
+#if defined(RNN_INT_NETWORK)
+    return "integer";
+#else
+#if defined(RNN_AVX512_VNNI)
+    if (rnn->compute_gru_fct == &compute_gru_vnni)
+        return "vnni";
+#endif
+#if defined(RNN_AVX512)
+    if (rnn->compute_gru_fct == &compute_gru_avx512)
+        return "avx512";
+#endif
+#if defined(__AVX2__)
+    if (rnn->compute_gru_fct == &compute_gru_avx2)
+        return "avx2";
+#endif
+    return "c";
+#endif
+}
+
+/* Runs the model over the input with both kernels, returns 1 if it drifts too far */
+static int check_model(const char *name, const float *x, int nb_frames)
+{
+    RNNModel *model = rnnoise_get_model(name);
+    DenoiseState *st = rnnoise_create(model);
+    DenoiseState *ref = rnnoise_create(model);
+    double gain_drift = 0, vad_drift = 0;
+    int frames = 0;
+    int i, j;
+
+    rnn_free_kernels(&ref->rnn);
+    rnn_init_generic_kernels(&ref->rnn);
+
+    for (i = 0; i < nb_frames; i++) {
+        kiss_fft_cpx X[FREQ_SIZE];
+        kiss_fft_cpx P[WINDOW_SIZE];
+        celt_sig in[FRAME_SIZE];
+        opus_val64 Ex[NB_BANDS], Ep[NB_BANDS];
+        opus_val16 Exp[NB_BANDS];
+        opus_val16 features[NB_FEATURES];
+        opus_val16 g[NB_BANDS], g_ref[NB_BANDS];
+        opus_val16 vad, vad_ref;
+        biquad_hp(in, st->mem_hp_x, &x[i * FRAME_SIZE], FRAME_SIZE, st->mode->hp_block);
+        if (compute_frame_features(st, X, P, Ex, Ep, Exp, features, in))
+            continue;
+        compute_rnn(&st->rnn, g, &vad, features);
+        compute_rnn(&ref->rnn, g_ref, &vad_ref, features);
+        for (j = 0; j < NB_BANDS; j++)
+            gain_drift = MAX32(gain_drift, fabs(g[j] - g_ref[j])/Q15ONE);
+        vad_drift = MAX32(vad_drift, fabs(vad - vad_ref)/Q15ONE);
+        frames++;
+    }
+
+    printf("%-5s %-8s %6d frames, max gain difference %.2e, max VAD difference %.2e\n",
+           name, gru_kernel_name(&st->rnn), frames, gain_drift, vad_drift);
+    rnnoise_destroy(st);
+    rnnoise_destroy(ref);
+    return gain_drift > MAX_GAIN_DRIFT || vad_drift > MAX_VAD_DRIFT;
+}
+
+int main(int argc, char **argv)
+{
+    const char **models = rnnoise_models();
+    float *x;
+    int nb_frames, failed = 0;
+    int i;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [input.raw]\n", argv[0]);
+        return 1;
+    }
+    x = argc == 2 ? read_input(argv[1], &nb_frames) : synthetic_input(&nb_frames);
+    if (!x || nb_frames == 0) {
+        fprintf(stderr, "no input audio\n");
+        return 1;
+    }
+
+    for (i = 0; models[i]; i++)
+        failed |= check_model(models[i], x, nb_frames);
+    if (failed)
+        fprintf(stderr, "drift above %.2f gain or %.2f VAD\n", MAX_GAIN_DRIFT, MAX_VAD_DRIFT);
+
+    free(x);
+    return failed;
+}
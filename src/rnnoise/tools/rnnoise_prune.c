@@ -0,0 +1,298 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Prunes the GRU weights of a model down to its strongest 4x8 blocks, writes
+ * the result as a version 2 model file, and compares the pruned model with
+ * the original one on some audio.
+ *
+ * Usage: rnnoise_prune <model name or file> <density> <output file> [input.raw]
+ *
+ * density is the fraction of blocks kept in each GRU weight matrix. input.raw
+ * is 48 kHz mono 16-bit PCM; a synthetic voice over noise is used otherwise. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rnn.h"
+#include "rnn_data.h"
+#include "rnnoise.h"
+#include "rnnoise-nu.h"
+
+#define FRAME_SIZE 480
+#define SYNTHETIC_FRAMES 1000
+
+typedef struct {
+    float score;
+    int group;
+    int row;
+} Block;
+
+static int compare_blocks(const void *a, const void *b)
+{
+    float sa = ((const Block *) a)->score;
+    float sb = ((const Block *) b)->score;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+    return ((const Block *) a)->row - ((const Block *) b)->row;
+}
+
+static int file_activation(int activation)
+{
+    /* See the F_ACTIVATION_* values in rnn_reader.c */
+    if (activation == ACTIVATION_SIGMOID)
+        return 1;
+    if (activation == ACTIVATION_RELU)
+        return 2;
+    return 0;
+}
+
+static void write_array(FILE *f, const rnn_weight *values, int len)
+{
+    int i;
+    for (i = 0; i < len; i++)
+        fprintf(f, "%d%c", values[i], i + 1 < len ? ' ' : '\n');
+}
+
+static void write_dense(FILE *f, const DenseLayer *layer)
+{
+    fprintf(f, "%d %d %d\n", layer->nb_inputs, layer->nb_neurons, file_activation(layer->activation));
+    write_array(f, layer->input_weights, layer->nb_inputs * layer->nb_neurons);
+    write_array(f, layer->bias, layer->nb_neurons);
+}
+
+/* Writes a rows x cols matrix keeping the density fraction of its blocks with
+   the largest absolute sum. Returns the number of blocks kept. */
+static int write_pruned_matrix(FILE *f, const rnn_weight *w, int rows, int cols, float density, int *total)
+{
+    int groups = cols / SPARSE_BLOCK_OUTPUTS;
+    int row_blocks = (rows + SPARSE_BLOCK_INPUTS - 1) / SPARSE_BLOCK_INPUTS;
+    int nb_blocks = groups * row_blocks;
+    int kept = (int) ceil(density * nb_blocks);
+    Block *blocks;
+    int g, b, i, k;
+
+    *total = nb_blocks;
+    if (cols % SPARSE_BLOCK_OUTPUTS || kept >= nb_blocks) {
+        fprintf(f, "0\n");
+        write_array(f, w, rows * cols);
+        return nb_blocks;
+    }
+    blocks = malloc(nb_blocks * sizeof(Block));
+    for (g = 0; g < groups; g++) {
+        for (b = 0; b < row_blocks; b++) {
+            Block *block = &blocks[g * row_blocks + b];
+            block->score = 0;
+            block->group = g;
+            block->row = b * SPARSE_BLOCK_INPUTS;
+            for (i = block->row; i < rows && i < block->row + SPARSE_BLOCK_INPUTS; i++)
+                for (k = 0; k < SPARSE_BLOCK_OUTPUTS; k++)
+                    block->score += abs(w[i * cols + g * SPARSE_BLOCK_OUTPUTS + k]);
+        }
+    }
+    qsort(blocks, nb_blocks, sizeof(Block), compare_blocks);
+
+    /* Regroup the kept blocks by output group, in input order */
+    for (i = 0; i < kept; i++)
+        blocks[i].row += blocks[i].group * rows;
+    qsort(blocks, kept, sizeof(Block), compare_rows);
+    for (i = 0; i < kept; i++)
+        blocks[i].row -= blocks[i].group * rows;
+
+    fprintf(f, "1\n");
+    for (g = 0, b = 0; g < groups; g++) {
+        int start = b;
+        while (b < kept && blocks[b].group == g)
+            b++;
+        fprintf(f, "%d", b - start);
+        for (i = start; i < b; i++)
+            fprintf(f, " %d", blocks[i].row);
+        fprintf(f, "\n");
+    }
+    for (b = 0; b < kept; b++) {
+        for (i = blocks[b].row; i < blocks[b].row + SPARSE_BLOCK_INPUTS; i++)
+            for (k = 0; k < SPARSE_BLOCK_OUTPUTS; k++)
+                fprintf(f, "%d ", i < rows ? w[i * cols + blocks[b].group * SPARSE_BLOCK_OUTPUTS + k] : 0);
+        fprintf(f, "\n");
+    }
+    free(blocks);
+    return kept;
+}
+
+static void write_pruned_gru(FILE *f, const GRULayer *layer, float density, int *kept, int *total)
+{
+    int n;
+    fprintf(f, "%d %d %d\n", layer->nb_inputs, layer->nb_neurons, file_activation(layer->activation));
+    *kept += write_pruned_matrix(f, layer->input_weights, layer->nb_inputs, 3 * layer->nb_neurons, density, &n);
+    *total += n;
+    *kept += write_pruned_matrix(f, layer->recurrent_weights, layer->nb_neurons, 3 * layer->nb_neurons, density, &n);
+    *total += n;
+    write_array(f, layer->bias, 3 * layer->nb_neurons);
+}
+
+static float *synthetic_input(int *nb_frames)
+{
+    float *x = malloc(SYNTHETIC_FRAMES * FRAME_SIZE * sizeof(float));
+    unsigned seed = 1;
+    int i;
+    for (i = 0; i < SYNTHETIC_FRAMES * FRAME_SIZE; i++) {
+        float t = i / 48000.f;
+        float envelope = .5f + .5f * sinf(2 * M_PI * 3 * t);
+        float voice = 0;
+        int h;
+        for (h = 1; h <= 10; h++)
+            voice += sinf(2 * M_PI * 140 * h * t) / h;
+        seed = seed * 1664525u + 1013904223u;
+        x[i] = 4000 * envelope * voice + 2000 * ((seed >> 8) / 16777216.f - .5f);
+    }
+    *nb_frames = SYNTHETIC_FRAMES;
+    return x;
+}
+
+static float *read_input(const char *path, int *nb_frames)
+{
+    FILE *f = fopen(path, "rb");
+    short pcm[FRAME_SIZE];
+    float *x = NULL;
+    int n = 0;
+    if (!f)
+        return NULL;
+    while (fread(pcm, sizeof(short), FRAME_SIZE, f) == FRAME_SIZE) {
+        int i;
+        x = realloc(x, (n + 1) * FRAME_SIZE * sizeof(float));
+        for (i = 0; i < FRAME_SIZE; i++)
+            x[n * FRAME_SIZE + i] = pcm[i];
+        n++;
+    }
+    fclose(f);
+    *nb_frames = n;
+    return x;
+}
+
+/* Runs the model over the input, returning the time spent per frame in us */
+static double run_model(RNNModel *model, const float *x, float *y, float *vad, int nb_frames)
+{
+    DenoiseState *st = rnnoise_create(model);
+    clock_t start = clock();
+    int i;
+    for (i = 0; i < nb_frames; i++)
+        vad[i] = rnnoise_process_frame(st, &y[i * FRAME_SIZE], &x[i * FRAME_SIZE]);
+    start = clock() - start;
+    rnnoise_destroy(st);
+    return 1e6 * start / CLOCKS_PER_SEC / nb_frames;
+}
+
+int main(int argc, char **argv)
+{
+    RNNModel *model, *pruned;
+    FILE *f;
+    float density;
+    float *x, *y0, *y1, *vad0, *vad1;
+    double t0, t1, signal = 0, error = 0, vad_error = 0;
+    int nb_frames, kept = 0, total = 0;
+    int i;
+
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "usage: %s <model name or file> <density> <output file> [input.raw]\n", argv[0]);
+        return 1;
+    }
+    density = atof(argv[2]);
+    if (!(density > 0 && density <= 1)) {
+        fprintf(stderr, "density must be in (0, 1]\n");
+        return 1;
+    }
+    model = rnnoise_get_model(argv[1]);
+    if (!model) {
+        f = fopen(argv[1], "r");
+        model = f ? rnnoise_model_from_file(f) : NULL;
+        if (f)
+            fclose(f);
+    }
+    if (!model) {
+        fprintf(stderr, "cannot load model %s\n", argv[1]);
+        return 1;
+    }
+
+    f = fopen(argv[3], "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", argv[3]);
+        return 1;
+    }
+    fprintf(f, "rnnoise-nu model file version 2\n");
+    write_dense(f, model->input_dense);
+    write_pruned_gru(f, model->vad_gru, density, &kept, &total);
+    write_pruned_gru(f, model->noise_gru, density, &kept, &total);
+    write_pruned_gru(f, model->denoise_gru, density, &kept, &total);
+    write_dense(f, model->denoise_output);
+    write_dense(f, model->vad_output);
+    fclose(f);
+
+    f = fopen(argv[3], "r");
+    pruned = f ? rnnoise_model_from_file(f) : NULL;
+    if (f)
+        fclose(f);
+    if (!pruned) {
+        fprintf(stderr, "cannot read back %s\n", argv[3]);
+        return 1;
+    }
+
+    x = argc == 5 ? read_input(argv[4], &nb_frames) : synthetic_input(&nb_frames);
+    if (!x || nb_frames == 0) {
+        fprintf(stderr, "no input audio\n");
+        return 1;
+    }
+    y0 = malloc(nb_frames * FRAME_SIZE * sizeof(float));
+    y1 = malloc(nb_frames * FRAME_SIZE * sizeof(float));
+    vad0 = malloc(nb_frames * sizeof(float));
+    vad1 = malloc(nb_frames * sizeof(float));
+    t0 = run_model(model, x, y0, vad0, nb_frames);
+    t1 = run_model(pruned, x, y1, vad1, nb_frames);
+    for (i = 0; i < nb_frames * FRAME_SIZE; i++) {
+        signal += (double) y0[i] * y0[i];
+        error += (double) (y1[i] - y0[i]) * (y1[i] - y0[i]);
+    }
+    for (i = 0; i < nb_frames; i++)
+        vad_error += fabs(vad1[i] - vad0[i]);
+
+    printf("GRU blocks kept:      %d / %d (%.1f%%)\n", kept, total, 100. * kept / total);
+    printf("output SNR vs dense:  %.2f dB\n", 10 * log10((signal + 1e-9) / (error + 1e-9)));
+    printf("mean VAD difference:  %.4f\n", vad_error / nb_frames);
+    printf("time per frame:       %.1f us dense, %.1f us pruned\n", t0, t1);
+
+    free(x);
+    free(y0);
+    free(y1);
+    free(vad0);
+    free(vad1);
+    rnnoise_model_free(pruned);
+    if (!rnnoise_get_model(argv[1]))
+        rnnoise_model_free(model);
+    return 0;
+}
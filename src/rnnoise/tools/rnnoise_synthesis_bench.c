@@ -0,0 +1,189 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Compares the fused frame synthesis of denoise.c with the separate passes it
+ * replaced: interpolating and applying the energy normalization and the band
+ * gains one after the other, mirroring the spectrum, the IFFT, windowing and
+ * overlap-add. Prints the time per 48 kHz frame of both, in TSC cycles where
+ * available, the relative difference, and the largest difference between
+ * their outputs. The IFFT dominates both, so expect a few percent at most.
+ *
+ * Usage: rnnoise_synthesis_bench */
+
+/* The synthesis is internal to denoise.c */
+#include "denoise.c"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define HAVE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#else
+#include <time.h>
+#endif
+
+#if defined(HAVE_RDTSC)
+#define TIMESTAMP_UNIT "cycles"
+#else
+#define TIMESTAMP_UNIT "ns"
+#endif
+
+#define NB_FRAMES 100
+#define NB_RUNS 200
+
+static unsigned long long timestamp(void)
+{
+#if defined(HAVE_RDTSC)
+    return __rdtsc();
+#else
+    return (unsigned long long) ((double) clock() * 1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* The synthesis before it was fused, as pitch_filter() and
+   rnnoise_process_frame() ran it */
+static void separate_synthesis(DenoiseState *st, const FrameMode *mode, float *out, const kiss_fft_cpx *X,
+                               const float *norm, const float *g)
+{
+    int i;
+    int frame_size = mode->frame_size;
+    int window_size = mode->window_size;
+    float normf[FREQ_SIZE] = {0};
+    float gf[FREQ_SIZE] = {0};
+    kiss_fft_cpx Y[FREQ_SIZE];
+    kiss_fft_cpx x[WINDOW_SIZE];
+    kiss_fft_cpx y[WINDOW_SIZE];
+    float z[WINDOW_SIZE];
+    interp_band_gain(normf, norm, mode);
+    for (i = 0; i < mode->freq_size; i++) {
+        Y[i].r = X[i].r * normf[i];
+        Y[i].i = X[i].i * normf[i];
+    }
+    interp_band_gain(gf, g, mode);
+    for (i = 0; i < mode->freq_size; i++) {
+        Y[i].r *= gf[i];
+        Y[i].i *= gf[i];
+    }
+    /* inverse_transform() */
+    for (i = 0; i < mode->freq_size; i++)
+        x[i] = Y[i];
+    for (; i < window_size; i++) {
+        x[i].r = x[window_size - i].r;
+        x[i].i = -x[window_size - i].i;
+    }
+    opus_fft(mode->kfft, x, y, 0);
+    z[0] = window_size * y[0].r;
+    for (i = 1; i < window_size; i++)
+        z[i] = window_size * y[window_size - i].r;
+    apply_window(mode, z);
+    for (i = 0; i < frame_size; i++)
+        out[i] = z[i] + st->synthesis_mem[i];
+    RNN_COPY(st->synthesis_mem, &z[frame_size], frame_size);
+}
+
+static void fused_synthesis(DenoiseState *st, const FrameMode *mode, float *out, const kiss_fft_cpx *X,
+                            const float *norm, const float *g)
+{
+    float gf[FREQ_SIZE];
+    interp_synthesis_gain(mode, gf, norm, g);
+    frame_synthesis(st, mode, out, X, gf, 1.f);
+}
+
+static kiss_fft_cpx X[NB_FRAMES][FREQ_SIZE];
+static float norm[NB_FRAMES][NB_BANDS];
+static float g[NB_FRAMES][NB_BANDS];
+static float out[2][NB_FRAMES][FRAME_SIZE];
+
+typedef void (*synthesis_fct)(DenoiseState *, const FrameMode *, float *, const kiss_fft_cpx *, const float *,
+                              const float *);
+
+/* Time per frame of the synthesis, the best of NB_RUNS passes over the frames.
+   The output of the last pass is left in y. */
+static double run(synthesis_fct synthesis, float (*y)[FRAME_SIZE])
+{
+    DenoiseState *st = rnnoise_create(NULL);
+    unsigned long long best = 0;
+    int i, run;
+    for (run = 0; run < NB_RUNS; run++) {
+        unsigned long long start;
+        RNN_CLEAR(st->synthesis_mem, FRAME_SIZE);
+        start = timestamp();
+        for (i = 0; i < NB_FRAMES; i++)
+            synthesis(st, &common.mode48, y[i], X[i], norm[i], g[i]);
+        start = timestamp() - start;
+        if (run == 0 || start < best)
+            best = start;
+    }
+    rnnoise_destroy(st);
+    return (double) best / NB_FRAMES;
+}
+
+int main(void)
+{
+    DenoiseState *st = rnnoise_create(NULL);
+    float in[FRAME_SIZE];
+    float Ex[NB_BANDS];
+    double separate, fused, max_error = 0, max_value = 0;
+    unsigned seed = 1;
+    int i, j;
+
+    /* Spectra of a synthetic voice over noise, with gains in the range the
+       network and the energy normalization produce */
+    for (i = 0; i < NB_FRAMES; i++) {
+        for (j = 0; j < FRAME_SIZE; j++) {
+            float t = (i * FRAME_SIZE + j) / 48000.f;
+            float voice = 0;
+            int h;
+            for (h = 1; h <= 10; h++)
+                voice += sinf(2 * M_PI * 140 * h * t) / h;
+            seed = seed * 1664525u + 1013904223u;
+            in[j] = 4000 * voice + 2000 * ((seed >> 8) / 16777216.f - .5f);
+        }
+        frame_analysis(st, X[i], Ex, in);
+        for (j = 0; j < NB_BANDS; j++) {
+            seed = seed * 1664525u + 1013904223u;
+            g[i][j] = (seed >> 8) / 16777216.f;
+        }
+        for (j = 0; j < NB_BANDS; j++)
+            norm[i][j] = .8f + .4f * g[i][(j * 7) % NB_BANDS];
+    }
+    rnnoise_destroy(st);
+
+    separate = run(separate_synthesis, out[0]);
+    fused = run(fused_synthesis, out[1]);
+    for (i = 0; i < NB_FRAMES; i++) {
+        for (j = 0; j < FRAME_SIZE; j++) {
+            max_error = MAX32(max_error, fabs(out[1][i][j] - out[0][i][j]));
+            max_value = MAX32(max_value, fabs(out[0][i][j]));
+        }
+    }
+
+    printf("separate  %.0f %s per frame\n", separate, TIMESTAMP_UNIT);
+    printf("fused     %.0f %s per frame\n", fused, TIMESTAMP_UNIT);
+    printf("fused vs separate %+.1f%% time\n", 100 * (fused / separate - 1));
+    printf("max difference %.2e of a peak of %.0f\n", max_error, max_value);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* Compares the rational tanh of tansig_approx.h with the table lookup it
+ * replaced: maximum absolute error against tanh() and time per element, for
+ * the scalar code and the SIMD widths this build was compiled for.
+ *
+ * Usage: rnnoise_tansig_bench */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "opus_types.h"
+#include "tansig_approx.h"
+#include "tansig_table.h"
+
+#define NB_VALUES 4096
+#define NB_RUNS 20000
+
+static float tansig_table_lookup(float x)
+{
+    int i;
+    float y, dy;
+    float sign = 1;
+    if (!(x < 8))
+        return 1;
+    if (!(x > -8))
+        return -1;
+    if (x != x)
+        return 0;
+    if (x < 0) {
+        x = -x;
+        sign = -1;
+    }
+    i = (int)floor(.5f + 25 * x);
+    x -= .04f * i;
+    y = tansig_table[i];
+    dy = 1 - y * y;
+    y = y + x * dy * (1 - y * x);
+    return sign * y;
+}
+
+static void run_table(float *y, const float *x, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        y[i] = tansig_table_lookup(x[i]);
+}
+
+static void run_rational(float *y, const float *x, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        y[i] = tansig_approx(x[i]);
+}
+
+#if defined(__AVX2__)
+static void run_avx2(float *y, const float *x, int n)
+{
+    int i;
+    for (i = 0; i < n; i += 8)
+        _mm256_storeu_ps(&y[i], tansig_approx8(_mm256_loadu_ps(&x[i])));
+}
+#endif
+
+#if defined(__AVX512F__)
+static void run_avx512(float *y, const float *x, int n)
+{
+    int i;
+    for (i = 0; i < n; i += 16)
+        _mm512_storeu_ps(&y[i], tansig_approx16(_mm512_loadu_ps(&x[i])));
+}
+#endif
+
+static float x[NB_VALUES];
+static float y[NB_VALUES];
+
+static void report(const char *name, void (*run)(float *, const float *, int))
+{
+    double max_error = 0;
+    clock_t start;
+    int i;
+    /* Error over a fine sweep of [-10, 10] */
+    for (i = 0; i < 2000000; i += NB_VALUES) {
+        int j;
+        for (j = 0; j < NB_VALUES; j++)
+            x[j] = -10.f + 20.f * (i + j) / 2000000;
+        run(y, x, NB_VALUES);
+        for (j = 0; j < NB_VALUES; j++) {
+            double error = fabs(y[j] - tanh(x[j]));
+            if (error > max_error)
+                max_error = error;
+        }
+    }
+    /* Timing on the range the GRU sums actually cover */
+    for (i = 0; i < NB_VALUES; i++)
+        x[i] = 4.f * sinf(.37f * i);
+    start = clock();
+    for (i = 0; i < NB_RUNS; i++)
+        run(y, x, NB_VALUES);
+    start = clock() - start;
+    printf("%-10s max error %.2e, %.3f ns per value\n", name, max_error,
+           1e9 * start / CLOCKS_PER_SEC / ((double) NB_RUNS * NB_VALUES));
+}
+
+int main(void)
+{
+    report("table", run_table);
+    report("rational", run_rational);
+#if defined(__AVX2__)
+    report("avx2", run_avx2);
+#endif
+#if defined(__AVX512F__)
+    report("avx512", run_avx512);
+#endif
+    return 0;
+}
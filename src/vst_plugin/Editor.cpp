@@ -17,7 +17,7 @@ void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 constexpr int WINDOW_WIDTH = 400;
-constexpr int WINDOW_HEIGHT = 150;
+constexpr int WINDOW_HEIGHT = 180;
 
 Editor::Editor(AudioEffect* effect)
     : AEffEditor::AEffEditor(effect),
@@ -82,6 +82,8 @@ bool Editor::isOpen()
 
 void Editor::idle()
 {
+    // On the host's GUI thread, unlike processReplacing()
+    static_cast<RnNoiseVstPlugin*>(effect)->updateInitialDelay();
 }
 
 void Editor::render(HWND hostWindow)
@@ -193,6 +195,11 @@ void Editor::render(HWND hostWindow)
                 ImGui::EndCombo();
             }
 
+            bool linked = plugin->isLinked();
+            if (ImGui::Checkbox("Link channels", &linked)) {
+                plugin->setLinked(linked);
+            }
+
             ImGui::End();
         }
 
@@ -1,8 +1,9 @@
 #include "RnNoiseVstPlugin.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
-#include <sstream>
+#include <cstring>
 
 #include "common/RnNoiseCommonPlugin.h"
 
@@ -15,36 +16,49 @@ RnNoiseVstPlugin::RnNoiseVstPlugin(audioMasterCallback audioMaster, VstInt32 num
 {
     setNumInputs(channels);
     setNumOutputs(channels);
-    setUniqueID(366057);
+    // Hosts tell the channel count variants apart by their id, the stereo one keeps the original
+    setUniqueID(channels == 2 ? 366057 : 366057 + 100 * channels);
     programsAreChunks(true);
     canProcessReplacing(); // supports replacing mode
     
     m_editor = new Editor(this);
     setEditor(m_editor);
 
-    for (int i = 0; i < channels; i++)
-        m_rnNoisePlugin.push_back(std::make_unique<RnNoiseCommonPlugin>());
+    m_rnNoisePlugin = std::make_unique<RnNoiseCommonPlugin>(channels);
 }
 
 RnNoiseVstPlugin::~RnNoiseVstPlugin() = default;
 
 void RnNoiseVstPlugin::processReplacing(float **inputs, float **outputs, VstInt32 sampleFrames) {
-    for (int i = 0; i < channels; i++)
-        m_rnNoisePlugin[i]->process(inputs[i], outputs[i], sampleFrames, paramVadThreshold, paramVadRelease);
+    m_rnNoisePlugin->process(inputs, outputs, sampleFrames, paramVadThreshold.load(std::memory_order_relaxed),
+                             paramVadRelease.load(std::memory_order_relaxed));
+
+    // Only grows if the host breaks from the block size it announced, it is reported from the editor's idle()
+    m_latency.store(static_cast<VstInt32>(m_rnNoisePlugin->getLatency()), std::memory_order_relaxed);
 }
 
-VstInt32 RnNoiseVstPlugin::startProcess() {
-    for (int i = 0; i < channels; i++)
-        m_rnNoisePlugin[i]->init();
+void RnNoiseVstPlugin::resume() {
+    // The host sets the sample rate and block size while suspended
+    m_rnNoisePlugin->init(static_cast<uint32_t>(sampleRate), static_cast<uint32_t>(getBlockSize()));
+    m_latency = static_cast<VstInt32>(m_rnNoisePlugin->getLatency());
+
+    updateInitialDelay();
+
+    AudioEffectX::resume();
+}
 
-    return AudioEffectX::startProcess();
+void RnNoiseVstPlugin::updateInitialDelay() {
+    const VstInt32 latency = m_latency.load(std::memory_order_relaxed);
+    if (latency != cEffect.initialDelay) {
+        setInitialDelay(latency);
+        ioChanged();
+    }
 }
 
-VstInt32 RnNoiseVstPlugin::stopProcess() {
-    for (int i = 0; i < channels; i++)
-        m_rnNoisePlugin[i]->deinit();
+void RnNoiseVstPlugin::suspend() {
+    m_rnNoisePlugin->deinit();
 
-    return AudioEffectX::stopProcess();
+    AudioEffectX::suspend();
 }
 
 bool RnNoiseVstPlugin::getEffectName(char *name) {
@@ -94,10 +108,10 @@ void RnNoiseVstPlugin::getParameterDisplay(VstInt32 index, char* label) {
     const auto paramIdx = static_cast<Parameters>(index);
     switch (paramIdx) {
         case Parameters::vadThreshold:
-            snprintf(label, VstStringConstants::kVstMaxParamStrLen, "%.2f", paramVadThreshold);
+            snprintf(label, VstStringConstants::kVstMaxParamStrLen, "%.2f", paramVadThreshold.load());
             break;
         case Parameters::vadRelease:
-            snprintf(label, VstStringConstants::kVstMaxParamStrLen, "%.3d", paramVadRelease * 10);
+            snprintf(label, VstStringConstants::kVstMaxParamStrLen, "%.3d", paramVadRelease.load() * 10);
             break;
     }
 }
@@ -125,35 +139,75 @@ void RnNoiseVstPlugin::setParameter(VstInt32 index, float value) {
 }
 
 VstInt32 RnNoiseVstPlugin::getChunk(void** data, bool isPreset) {
-    std::stringstream s;
-    s << std::to_string(paramVadThreshold)  << std::endl << std::to_string(paramVadRelease) << std::endl << getCurrentModel();
-    m_settings = s.str();
-    *data = static_cast<void*>(&m_settings[0]);
-    return static_cast<VstInt32>(m_settings.length());
+    RnNoiseSettings settings;
+    settings.vadThreshold = paramVadThreshold;
+    settings.vadRelease = paramVadRelease;
+    settings.modelIndex = RnNoiseSettings::findModel(getCurrentModel());
+    settings.flags = isLinked() ? static_cast<uint32_t>(RnNoiseSettings::linked) : 0u;
+
+    m_settings = settings.serialize();
+    *data = static_cast<void*>(m_settings.data());
+    return static_cast<VstInt32>(m_settings.size());
+}
+
+/**
+ * Chunks saved before the binary format are text, the threshold, release, model name and,
+ * since channels can be linked, the linked flag, one per line.
+ */
+static bool parseTextChunk(const void *data, VstInt32 byteSize, RnNoiseSettings &settings) {
+    char text[128];
+    if (data == nullptr || byteSize <= 0 || static_cast<size_t>(byteSize) >= sizeof(text)) {
+        return false;
+    }
+    std::memcpy(text, data, static_cast<size_t>(byteSize));
+    text[byteSize] = '\0';
+
+    float vadThreshold;
+    short vadRelease;
+    char model[64];
+    int linked = 0;
+    if (std::sscanf(text, "%f %hd %63s %d", &vadThreshold, &vadRelease, model, &linked) < 3 ||
+        !std::isfinite(vadThreshold)) {
+        return false;
+    }
+
+    settings.vadThreshold = std::max(std::min(vadThreshold, 1.f), 0.f);
+    settings.vadRelease = std::max<short>(std::min<short>(vadRelease, 100), 0);
+    settings.modelIndex = RnNoiseSettings::findModel(model);
+    settings.flags = linked != 0 ? static_cast<uint32_t>(RnNoiseSettings::linked) : 0u;
+    return true;
 }
 
 VstInt32 RnNoiseVstPlugin::setChunk(void* data, VstInt32 byteSize, bool isPreset) {
-    m_settings.assign(static_cast<char*>(data), byteSize);
-    std::stringstream s(m_settings);
-    std::string vadThreshold, vadRelease, model;
-
-    s >> vadThreshold >> vadRelease >> model;
+    RnNoiseSettings settings;
+    if (byteSize < 0 || (!settings.parse(data, static_cast<size_t>(byteSize)) &&
+                         !parseTextChunk(data, byteSize, settings))) {
+        // Leave the settings as they are rather than half apply garbage
+        return 0;
+    }
 
-    paramVadThreshold = std::stof(vadThreshold);
-    paramVadRelease = std::stoi(vadRelease);
-    setModel(model);
+    paramVadThreshold = settings.vadThreshold;
+    paramVadRelease = settings.vadRelease;
+    setModel(RnNoiseCommonPlugin::getAvailableModels()[settings.modelIndex]);
+    setLinked((settings.flags & RnNoiseSettings::linked) != 0);
 
     return 0; // error code: https://www.kvraudio.com/forum/viewtopic.php?p=5639784&sid=08f756e80d6209008b7b5d29042c07fe#p5639784
 }
 
 const std::string& RnNoiseVstPlugin::getCurrentModel() {
-    return m_rnNoisePlugin[0]->getCurrentModel();
+    return m_rnNoisePlugin->getCurrentModel();
 }
 
 void RnNoiseVstPlugin::setModel(std::string name) {
-    for (auto& it : m_rnNoisePlugin) {
-        it->setModel(name);
-    }
+    m_rnNoisePlugin->setModel(name);
+}
+
+bool RnNoiseVstPlugin::isLinked() {
+    return m_rnNoisePlugin->isLinked();
+}
+
+void RnNoiseVstPlugin::setLinked(bool linked) {
+    m_rnNoisePlugin->setLinked(linked);
 }
 
 const std::vector<std::string> RnNoiseVstPlugin::getAvailableModels() {
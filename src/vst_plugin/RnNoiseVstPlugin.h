@@ -1,9 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include "vst2.x/audioeffectx.h"
 #include "Editor.h"
+#include "common/RnNoiseSettings.h"
+
+#ifndef RNNOISE_VST_CHANNELS
+#define RNNOISE_VST_CHANNELS 2
+#endif
 
 class RnNoiseCommonPlugin;
 
@@ -14,9 +20,9 @@ public:
 
     ~RnNoiseVstPlugin() override;
 
-    VstInt32 startProcess() override;
+    void resume() override;
 
-    VstInt32 stopProcess() override;
+    void suspend() override;
 
     void processReplacing(float **inputs, float **outputs, VstInt32 sampleFrames) override;
 
@@ -54,9 +60,20 @@ public:
 
     void setModel(std::string name);
 
+    bool isLinked();
+
+    void setLinked(bool linked);
+
     const std::vector<std::string> getAvailableModels();
 
+    /**
+     * Reports the latency of the denoisers to the host when it changes. Hosts do not expect ioChanged() from the
+     * audio thread, so this runs in resume() and the editor's idle().
+     */
+    void updateInitialDelay();
+
 private:
+
     static const char* s_effectName;
 
     static const char* s_productString;
@@ -68,19 +85,28 @@ private:
         vadRelease = 1
     };    
     
+    // The parameters are set by the host, the editor's render thread and setChunk(), while processReplacing()
+    // reads them on the audio thread. The common plugin ramps to a new threshold.
+
     // Parameter: VAD Threshold
     const char* paramVadThresholdLabel = "";
     const char* paramVadThresholdName = "VAD Threshold";
-    float paramVadThreshold{0.f};
+    std::atomic<float> paramVadThreshold{0.f};
 
     // Parameter: VAD Release
     const char* paramVadReleaseLabel = "ms";
     const char* paramVadReleaseName = "VAD Release";
-    short paramVadRelease{35};
+    std::atomic<short> paramVadRelease{35};
 
-    const int channels = 2;
+    // Set by the build, one binary per channel count
+    const int channels = RNNOISE_VST_CHANNELS;
      
-    std::vector<std::unique_ptr<RnNoiseCommonPlugin>> m_rnNoisePlugin;
+    std::unique_ptr<RnNoiseCommonPlugin> m_rnNoisePlugin;
+
+    /**
+     * The latency after the last processReplacing(), for updateInitialDelay().
+     */
+    std::atomic<VstInt32> m_latency{0};
     Editor* m_editor;
-    std::string m_settings;
+    RnNoiseSettings::Blob m_settings;
 };
\ No newline at end of file